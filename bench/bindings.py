@@ -0,0 +1,402 @@
+'''
+Benchmarks of the Python bindings layer
+
+Measures the cost of the operations which Python code performs on lvgl:
+object creation and deletion, method calls for various argument shapes,
+struct field access, style construction, get_children on a wide tree, event
+callback dispatch, full-screen rendering, framebuffer export, 1000
+simultaneous animations, run natively (lvgl.Anim) or from Python, and
+switching between screens, rebuilt or kept in an lvgl.ScreenPool, and
+building, traversing and deleting trees (tree_churn; compare with
+lvgl.set_freelist_size(0, 0) to measure the free lists).
+
+Run from the directory which contains the built lvgl module (see setup.py):
+
+    python bench/bindings.py -o results.json
+    python bench/bindings.py --compare results.json
+
+The results (median and minimum time per operation over the repeats) are
+written as json, so runs on different commits can be compared.
+
+The benchmarks with 1000 objects do not fit in the default lvgl heap
+(LV_MEM_SIZE) and are skipped, unless the module is built with the arena
+allocator (LVGL_MEM_ARENA=1 python setup.py build).
+'''
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+import lvgl
+
+BENCHMARKS = []
+
+# Approximate lvgl heap use of an lv_obj and of a running animation
+OBJ_HEAP_SIZE = 128
+ANIM_HEAP_SIZE = 64
+
+class Skip(Exception):
+    pass
+
+def benchmark(ops, unit='op'):
+    '''
+    Register a benchmark. The decorated function sets up the benchmark and
+    returns a function which performs ops operations when called.
+    '''
+    def decorator(setup):
+        BENCHMARKS.append((setup.__name__, setup, ops, unit))
+        return setup
+    return decorator
+
+
+def require_heap(nbytes):
+    '''
+    Skip the benchmark if the lvgl heap does not have nbytes free
+    '''
+    free = lvgl.mem_info()['free_biggest_size']
+    if free < nbytes:
+        raise Skip(f'needs {nbytes} bytes of lvgl heap, {free} free')
+
+
+def new_screen():
+    scr = lvgl.Obj()
+    lvgl.scr_load(scr)
+    lvgl.poll(0)
+    return scr
+
+
+@benchmark(ops=100)
+def obj_create_delete():
+    scr = new_screen()
+    def run():
+        for i in range(100):
+            lvgl.Obj(scr).del_()
+    return run
+
+@benchmark(ops=100)
+def btn_create_delete():
+    scr = new_screen()
+    def run():
+        for i in range(100):
+            lvgl.Btn(scr).del_()
+    return run
+
+@benchmark(ops=1000)
+def call_noargs():
+    obj = lvgl.Obj(new_screen())
+    def run():
+        get_x = obj.get_x
+        for i in range(1000):
+            get_x()
+    return run
+
+@benchmark(ops=1000)
+def call_int():
+    obj = lvgl.Obj(new_screen())
+    def run():
+        set_x = obj.set_x
+        for i in range(1000):
+            set_x(5)
+    return run
+
+@benchmark(ops=1000)
+def call_int_int():
+    obj = lvgl.Obj(new_screen())
+    def run():
+        set_pos = obj.set_pos
+        for i in range(1000):
+            set_pos(1, 2)
+    return run
+
+@benchmark(ops=1000)
+def call_kwargs():
+    obj = lvgl.Obj(new_screen())
+    def run():
+        set_pos = obj.set_pos
+        for i in range(1000):
+            set_pos(x=1, y=2)
+    return run
+
+@benchmark(ops=1000)
+def call_obj_arg():
+    scr = new_screen()
+    obj = lvgl.Obj(scr)
+    align = lvgl.ALIGN.CENTER
+    def run():
+        for i in range(1000):
+            obj.align(scr, align, 0, 0)
+    return run
+
+@benchmark(ops=1000)
+def call_str_arg():
+    label = lvgl.Label(new_screen())
+    def run():
+        set_text = label.set_text
+        for i in range(1000):
+            set_text('hello')
+    return run
+
+@benchmark(ops=1000)
+def call_returns_obj():
+    obj = lvgl.Obj(new_screen())
+    def run():
+        get_parent = obj.get_parent
+        for i in range(1000):
+            get_parent()
+    return run
+
+@benchmark(ops=1000)
+def struct_get():
+    area = lvgl.area_t()
+    def run():
+        for i in range(1000):
+            area.x1
+    return run
+
+@benchmark(ops=1000)
+def struct_set():
+    area = lvgl.area_t()
+    def run():
+        for i in range(1000):
+            area.x1 = 5
+    return run
+
+@benchmark(ops=1000)
+def substruct_get():
+    style = lvgl.style_t()
+    def run():
+        for i in range(1000):
+            style.body.radius
+    return run
+
+@benchmark(ops=1000)
+def style_create():
+    def run():
+        for i in range(1000):
+            lvgl.style_t()
+    return run
+
+@benchmark(ops=1, unit='call')
+def get_children_1000():
+    require_heap(1000 * OBJ_HEAP_SIZE)
+    scr = new_screen()
+    children = [lvgl.Obj(scr) for i in range(1000)]
+    def run():
+        scr.get_children()
+    run.keep = children
+    return run
+
+@benchmark(ops=10, unit='click')
+def event_dispatch():
+    scr = new_screen()
+    btn = lvgl.Btn(scr)
+    btn.set_pos(0, 0)
+    btn.set_size(50, 50)
+    events = []
+    btn.set_event_cb(events.append)
+    device = lvgl.InputDevice()
+    def run():
+        for i in range(10):
+            device.push_events([(10, 10, 1, 0), (10, 10, 0, 0)])
+            lvgl.poll(40)
+        assert events, 'no events dispatched'
+        events.clear()
+    run.keep = device
+    return run
+
+@benchmark(ops=1, unit='frame')
+def render_fullscreen():
+    scr = new_screen()
+    for i in range(20):
+        lvgl.Label(scr).set_text('label %d' % i)
+    def run():
+        scr.invalidate()
+        lvgl.poll(40)
+    return run
+
+@benchmark(ops=10, unit='frame')
+def framebuffer_export():
+    new_screen()
+    def run():
+        for i in range(10):
+            bytes(lvgl.framebuffer)
+    return run
+
+@benchmark(ops=1, unit='frame')
+def anim_1000_native():
+    require_heap(1000 * (OBJ_HEAP_SIZE + ANIM_HEAP_SIZE))
+    scr = new_screen()
+    anims = []
+    for i in range(1000):
+        anim = lvgl.Anim(lvgl.Obj(scr), 'x', 0, 200, time=1000)
+        anim.set_repeat(0)
+        anim.start()
+        anims.append(anim)
+    def run():
+        lvgl.poll(16)
+    run.teardown = lambda: [anim.stop() for anim in anims]
+    return run
+
+@benchmark(ops=1, unit='frame')
+def anim_1000_python():
+    require_heap(1000 * OBJ_HEAP_SIZE)
+    scr = new_screen()
+    objs = [lvgl.Obj(scr) for i in range(1000)]
+    frame = [0]
+    def run():
+        frame[0] += 1
+        x = frame[0] * 16 * 200 // 1000 % 200
+        for obj in objs:
+            obj.set_x(x)
+        lvgl.poll(16)
+    run.keep = objs
+    return run
+
+def build_screen(key):
+    scr = lvgl.Obj()
+    for i in range(50):
+        lvgl.Label(lvgl.Cont(scr)).set_text('%s %d' % (key, i))
+    return scr
+
+@benchmark(ops=2, unit='switch')
+def screen_switch_rebuild():
+    require_heap(2 * 101 * OBJ_HEAP_SIZE)
+    def run():
+        for key in ('a', 'b'):
+            lvgl.scr_load(build_screen(key))
+            lvgl.poll(0)
+    return run
+
+@benchmark(ops=2, unit='switch')
+def screen_switch_pool():
+    require_heap(2 * 101 * OBJ_HEAP_SIZE)
+    pool = lvgl.ScreenPool(build_screen, capacity=2)
+    def run():
+        for key in ('a', 'b'):
+            pool.show(key)
+            lvgl.poll(0)
+    run.teardown = lambda: pool.discard()
+    return run
+
+@benchmark(ops=1, unit='tree')
+def delete_tree_100():
+    require_heap(101 * OBJ_HEAP_SIZE)
+    scr = new_screen()
+    def run():
+        panel = lvgl.Cont(scr)
+        children = [lvgl.Btn(panel) for i in range(100)]
+        panel.delete_tree()
+    return run
+
+@benchmark(ops=100, unit='obj')
+def tree_churn():
+    '''
+    Build a tree, traverse it and delete it again, which creates and releases
+    a Python object per lvgl object, and a struct object per style access
+    '''
+    require_heap(101 * OBJ_HEAP_SIZE)
+    scr = new_screen()
+    style = lvgl.style_t()
+    def run():
+        panel = lvgl.Cont(scr)
+        for i in range(100):
+            lvgl.Btn(panel)
+        for child in panel.get_children():
+            child.get_x()
+            style.body.radius
+        panel.del_()
+    return run
+
+
+def measure(setup, repeat, min_time):
+    run = setup()
+    run() # warm-up
+
+    # Calibrate the number of loops such that a repeat takes at least min_time
+    loops = 1
+    while True:
+        t0 = time.perf_counter()
+        for i in range(loops):
+            run()
+        if time.perf_counter() - t0 >= min_time:
+            break
+        loops *= 2
+
+    times = []
+    for r in range(repeat):
+        t0 = time.perf_counter()
+        for i in range(loops):
+            run()
+        times.append((time.perf_counter() - t0) / loops)
+    
+    if hasattr(run, 'teardown'):
+        run.teardown()
+    return times
+
+def git_commit():
+    try:
+        return subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD'], cwd=ROOT, stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-r', '--repeat', type=int, default=5, help='number of repeats per benchmark')
+    parser.add_argument('--min-time', type=float, default=0.1, help='minimum time per repeat in seconds')
+    parser.add_argument('-k', '--filter', help='only run benchmarks whose name contains this string')
+    parser.add_argument('-o', '--output', help='write the results as json to this file')
+    parser.add_argument('--compare', help='compare with the results in this json file')
+    args = parser.parse_args()
+
+    results = {}
+    for name, setup, ops, unit in BENCHMARKS:
+        if args.filter and args.filter not in name:
+            continue
+        try:
+            times = [t / ops for t in measure(setup, args.repeat, args.min_time)]
+        except Skip as e:
+            print(f'{name:22s} skipped: {e}')
+            continue
+        results[name] = {'unit': unit, 'median_ns': statistics.median(times) * 1e9, 'min_ns': min(times) * 1e9}
+
+    baseline = None
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)['results']
+
+    if 'framebuffer_export' in results:
+        size = len(lvgl.framebuffer)
+        results['framebuffer_export']['bytes'] = size
+        results['framebuffer_export']['mb_per_s'] = size / results['framebuffer_export']['median_ns'] * 1e3
+
+    for name, result in results.items():
+        line = f'{name:22s} {result["median_ns"]:12.0f} ns/{result["unit"]:6s} (min {result["min_ns"]:.0f})'
+        if 'mb_per_s' in result:
+            line += f'   {result["mb_per_s"]:.0f} MB/s'
+        if baseline and name in baseline:
+            line += f'   {result["median_ns"] / baseline[name]["median_ns"]:6.2f}x'
+        print(line)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump({
+                'meta': {
+                    'commit': git_commit(),
+                    'date': datetime.datetime.now().isoformat(timespec='seconds'),
+                    'python': sys.version,
+                    'platform': platform.platform(),
+                },
+                'results': results,
+            }, f, indent=2)
+
+if __name__ == '__main__':
+    main()
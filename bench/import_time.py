@@ -0,0 +1,57 @@
+'''
+Measure the time taken by 'import lvgl', and by the first access of some
+lazily created module attributes (types, enum classes, colors)
+
+Each measurement runs in a fresh interpreter. Run from the directory which
+contains the built lvgl module (see setup.py), e.g.:
+
+    python bench/import_time.py -n 20
+'''
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+MEASURE = r'''
+import time, json
+t0 = time.perf_counter()
+import lvgl
+t1 = time.perf_counter()
+lvgl.Btn
+lvgl.ALIGN.IN_TOP_MID
+lvgl.COLOR.RED
+lvgl.style_plain
+t2 = time.perf_counter()
+print(json.dumps({'import': t1 - t0, 'first_access': t2 - t1}))
+'''
+
+def run_once():
+    out = subprocess.check_output([sys.executable, '-c', MEASURE], cwd=ROOT)
+    return json.loads(out)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('-n', '--runs', type=int, default=10, help='number of fresh interpreters to measure')
+    parser.add_argument('--json', action='store_true', help='print results as json')
+    args = parser.parse_args()
+    
+    runs = [run_once() for i in range(args.runs)]
+    
+    result = {}
+    for key in 'import', 'first_access':
+        values = [run[key] for run in runs]
+        result[key] = {'min': min(values), 'median': statistics.median(values)}
+    
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        for key, value in result.items():
+            print(f'{key:15s} min {value["min"]*1e3:8.3f} ms   median {value["median"]*1e3:8.3f} ms')
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,41 @@
+'''
+Drive lvgl from an asyncio event loop using lvgl.aio
+
+The button label counts down using a coroutine event callback, after which the
+button is deleted and the demo ends.
+'''
+import sys
+sys.path.append('..')
+import asyncio
+import lvgl
+
+async def main():
+    lvgl.aio.start()
+
+    scr = lvgl.Obj()
+    btn = lvgl.Btn(scr)
+    btn.align(scr, lvgl.ALIGN.CENTER, 0, 0)
+    label = lvgl.Label(btn)
+    label.set_text('Click me')
+    lvgl.scr_load(scr)
+
+    async def event_cb(event):
+        if event == lvgl.EVENT.CLICKED:
+            for i in range(3, 0, -1):
+                label.set_text(str(i))
+                await asyncio.sleep(1)
+            btn.del_()
+
+    btn.set_event_cb(event_cb)
+
+    # Simulate a click
+    lvgl.send_mouse_event(lvgl.HOR_RES // 2, lvgl.VER_RES // 2, True)
+    await asyncio.sleep(0.1)
+    lvgl.send_mouse_event(lvgl.HOR_RES // 2, lvgl.VER_RES // 2, False)
+
+    await lvgl.aio.deleted(btn)
+    print('button deleted')
+
+    lvgl.aio.stop()
+
+asyncio.run(main())
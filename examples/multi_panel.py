@@ -0,0 +1,83 @@
+'''
+Run several independent lvgl panels, each in its own subinterpreter
+
+Every interpreter which imports lvgl gets its own module instance with its own
+display, framebuffer and input device. lvgl itself is shared by the whole
+process, so the panels are rendered one at a time (serialized by the GIL and
+the lvgl lock).
+
+Requires CPython 3.9 or later. It uses the private subinterpreter module,
+_xxsubinterpreters (3.9-3.12) or _interpreters (3.13+). The interpreters are
+created with the legacy configuration (sharing the GIL of the main
+interpreter): the lvgl module cannot be imported in an interpreter with its
+own GIL, which is the default since 3.12.
+'''
+import os
+import sys
+import tempfile
+import threading
+
+try:
+    import _interpreters as interpreters
+except ImportError:
+    import _xxsubinterpreters as interpreters
+
+N_PANELS = 4
+
+panel_code = '''
+import sys
+sys.path.append('..')
+import lvgl
+
+scr = lvgl.Obj()
+label = lvgl.Label(scr)
+label.set_text('Panel %d' % index)
+label.align(scr, lvgl.ALIGN.IN_TOP_LEFT, 10 + 40 * index, 10)
+lvgl.scr_load(scr)
+
+for i in range(100):
+    lvgl.poll()
+
+with open(path, 'wb') as f:
+    f.write(lvgl.framebuffer)
+'''
+
+def create_interpreter():
+    if sys.version_info >= (3, 13):
+        return interpreters.create('legacy')
+    try:
+        return interpreters.create(isolated=False)
+    except TypeError:
+        return interpreters.create() # 3.9: there are only legacy interpreters
+
+def run_panel(interp, index, path):
+    # The values are passed in the code, since the ways to share objects with
+    # an interpreter differ between Python versions
+    code = f'index = {index!r}\npath = {path!r}\n' + panel_code
+    error = interpreters.run_string(interp, code) # 3.13+ returns the error instead of raising it
+    if error is not None:
+        raise RuntimeError(f'panel {index} failed: {error}')
+
+if __name__ == '__main__':
+    interps = [create_interpreter() for i in range(N_PANELS)]
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        paths = [os.path.join(tmpdir, f'panel{index}.bin') for index in range(N_PANELS)]
+        threads = [threading.Thread(target=run_panel, args=(interp, index, path))
+                    for index, (interp, path) in enumerate(zip(interps, paths))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        framebuffers = []
+        for path in paths:
+            with open(path, 'rb') as f:
+                framebuffers.append(f.read())
+
+    for interp in interps:
+        interpreters.destroy(interp)
+
+    # Every panel rendered its own screen into its own framebuffer
+    assert len(set(framebuffers)) == N_PANELS
+    print('%d independent panels rendered' % N_PANELS)
@@ -55,8 +55,14 @@
 /* LittelvGL's internal memory manager's settings.
  * The graphical objects and other related data are stored here. */
 
+/* PYLV_MEM_ARENA (set by setup.py when LVGL_MEM_ARENA=1) routes the lvgl
+ * heap to the arena allocator of lvglmodule.c, see lvgl_mem.h */
+#ifndef PYLV_MEM_ARENA
+#  define PYLV_MEM_ARENA     0
+#endif
+
 /* 1: use custom malloc/free, 0: use the built-in `lv_mem_alloc` and `lv_mem_free` */
-#define LV_MEM_CUSTOM      0
+#define LV_MEM_CUSTOM      PYLV_MEM_ARENA
 #if LV_MEM_CUSTOM == 0
 /* Size of the memory used by `lv_mem_alloc` in bytes (>= 2kB)*/
 #  define LV_MEM_SIZE    (32U * 1024U)
@@ -71,9 +77,10 @@
 /* Automatically defrag. on free. Defrag. means joining the adjacent free cells. */
 #  define LV_MEM_AUTO_DEFRAG  1
 #else       /*LV_MEM_CUSTOM*/
-#  define LV_MEM_CUSTOM_INCLUDE <stdlib.h>   /*Header for the dynamic memory function*/
-#  define LV_MEM_CUSTOM_ALLOC   malloc       /*Wrapper to malloc*/
-#  define LV_MEM_CUSTOM_FREE    free         /*Wrapper to free*/
+#  define LV_MEM_CUSTOM_INCLUDE "lvgl_mem.h"   /*Header for the dynamic memory function*/
+#  define LV_MEM_CUSTOM_ALLOC   pylv_mem_alloc /*Wrapper to malloc*/
+#  define LV_MEM_CUSTOM_FREE    pylv_mem_free  /*Wrapper to free*/
+#  define LV_MEM_CUSTOM_REALLOC pylv_mem_realloc /*Wrapper to realloc (only used with LV_ENABLE_GC)*/
 #endif     /*LV_MEM_CUSTOM*/
 
 /* Garbage Collector settings
@@ -208,7 +215,12 @@ typedef void * lv_indev_drv_user_data_t;            /*Type of user data in the i
 /*================
  *  THEME USAGE
  *================*/
-#define LV_THEME_LIVE_UPDATE    0   /*1: Allow theme switching at run time. Uses 8..10 kB of RAM*/
+/* PYLV_THEME_LIVE_UPDATE (set by setup.py when LVGL_THEME_LIVE_UPDATE=1)
+ * lets lvgl.Theme.apply() re-theme the existing objects */
+#ifndef PYLV_THEME_LIVE_UPDATE
+#  define PYLV_THEME_LIVE_UPDATE 0
+#endif
+#define LV_THEME_LIVE_UPDATE    PYLV_THEME_LIVE_UPDATE   /*1: Allow theme switching at run time. Uses 8..10 kB of RAM*/
 
 #define LV_USE_THEME_TEMPL      1   /*Just for test*/
 #define LV_USE_THEME_DEFAULT    1   /*Built mainly from the built-in styles. Consumes very few RAM*/
@@ -223,30 +235,42 @@ typedef void * lv_indev_drv_user_data_t;            /*Type of user data in the i
  *    FONT USAGE
  *===================*/
 
+/* PYLV_BUILTIN_FONTS (cleared by setup.py when LVGL_BUILTIN_FONTS=0) builds
+ * all built-in fonts. Without it, only DejaVu 20 and its symbols (the default
+ * font) are built in, other fonts can be loaded with lvgl.Font */
+#ifndef PYLV_BUILTIN_FONTS
+#  define PYLV_BUILTIN_FONTS 1
+#endif
+#if PYLV_BUILTIN_FONTS
+#  define PYLV_FONT_BPP      4
+#else
+#  define PYLV_FONT_BPP      0
+#endif
+
 /* More info about fonts: https://docs.littlevgl.com/#Fonts
  * To enable a built-in font use 1,2,4 or 8 values
  * which will determine the bit-per-pixel. Higher value means smoother fonts */
-#define LV_USE_FONT_DEJAVU_10              4
-#define LV_USE_FONT_DEJAVU_10_LATIN_SUP    4
-#define LV_USE_FONT_DEJAVU_10_CYRILLIC     4
-#define LV_USE_FONT_SYMBOL_10              4
+#define LV_USE_FONT_DEJAVU_10              PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_10_LATIN_SUP    PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_10_CYRILLIC     PYLV_FONT_BPP
+#define LV_USE_FONT_SYMBOL_10              PYLV_FONT_BPP
 
 #define LV_USE_FONT_DEJAVU_20              4
-#define LV_USE_FONT_DEJAVU_20_LATIN_SUP    4
-#define LV_USE_FONT_DEJAVU_20_CYRILLIC     4
+#define LV_USE_FONT_DEJAVU_20_LATIN_SUP    PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_20_CYRILLIC     PYLV_FONT_BPP
 #define LV_USE_FONT_SYMBOL_20              4
 
-#define LV_USE_FONT_DEJAVU_30              4
-#define LV_USE_FONT_DEJAVU_30_LATIN_SUP    4
-#define LV_USE_FONT_DEJAVU_30_CYRILLIC     4
-#define LV_USE_FONT_SYMBOL_30              4
+#define LV_USE_FONT_DEJAVU_30              PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_30_LATIN_SUP    PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_30_CYRILLIC     PYLV_FONT_BPP
+#define LV_USE_FONT_SYMBOL_30              PYLV_FONT_BPP
 
-#define LV_USE_FONT_DEJAVU_40              4
-#define LV_USE_FONT_DEJAVU_40_LATIN_SUP    4
-#define LV_USE_FONT_DEJAVU_40_CYRILLIC     4
-#define LV_USE_FONT_SYMBOL_40              4
+#define LV_USE_FONT_DEJAVU_40              PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_40_LATIN_SUP    PYLV_FONT_BPP
+#define LV_USE_FONT_DEJAVU_40_CYRILLIC     PYLV_FONT_BPP
+#define LV_USE_FONT_SYMBOL_40              PYLV_FONT_BPP
 
-#define LV_USE_FONT_MONOSPACE_8            1
+#define LV_USE_FONT_MONOSPACE_8            PYLV_BUILTIN_FONTS
 
 /* Optionally declare your custom fonts here.
  * You can use these fonts as default font too
@@ -0,0 +1,148 @@
+'''
+asyncio integration for lvgl, available as lvgl.aio
+
+lvgl is driven from the asyncio event loop: lv_task_handler is run when the
+next lvgl task is due (see lvgl.next_task_deadline_ms), or when lvgl is used
+(e.g. input is sent or an object is changed), instead of calling lvgl.poll()
+at a fixed rate from a timer. The waiting is done by lvgl.wait() in a helper
+thread, so an idle screen does not wake up the event loop.
+
+Event callbacks may be coroutine functions; they are scheduled as tasks on the
+event loop, so they do not block rendering.
+
+Example:
+
+    import asyncio
+    import lvgl
+
+    async def main():
+        lvgl.aio.start()
+
+        btn = lvgl.Btn(lvgl.scr_act())
+
+        async def event_cb(event):
+            if event == lvgl.EVENT.CLICKED:
+                await asyncio.sleep(1)
+                btn.del_()
+
+        btn.set_event_cb(event_cb)
+        await lvgl.aio.deleted(btn)
+
+    asyncio.run(main())
+'''
+import asyncio
+import concurrent.futures
+import lvgl
+
+_run_task = None
+_event_tasks = set()
+_animation_waiters = []
+
+
+def _check_animations():
+    # anim_count_running() only queries lvgl, so unlike other calls it does not
+    # make the next lvgl.wait() return immediately
+    if _animation_waiters and lvgl.anim_count_running() == 0:
+        for future in _animation_waiters:
+            if not future.done():
+                future.set_result(None)
+        _animation_waiters.clear()
+
+
+async def run():
+    '''
+    Drive lvgl from the running event loop, until cancelled
+    '''
+    loop = asyncio.get_running_loop()
+
+    def event_task_done(task):
+        _event_tasks.discard(task)
+        if not task.cancelled() and task.exception() is not None:
+            loop.call_exception_handler({
+                'message': 'Exception in lvgl event callback',
+                'exception': task.exception(),
+                'task': task,
+            })
+
+    def run_coroutine(coro):
+        task = loop.create_task(coro)
+        _event_tasks.add(task)
+        task.add_done_callback(event_task_done)
+        return task
+
+    lvgl._set_coroutine_runner(run_coroutine)
+    waiter = concurrent.futures.ThreadPoolExecutor(1, thread_name_prefix='lvgl.aio')
+    try:
+        last = loop.time()
+        while True:
+            # Advance the lvgl tick by the elapsed time in whole ms; the
+            # remainder is carried over to the next run
+            elapsed_ms = int((loop.time() - last) * 1000)
+            last += elapsed_ms / 1000
+
+            lvgl.poll(elapsed_ms)
+            _check_animations()
+
+            # Let coroutines which were woken up by the callbacks run first
+            await asyncio.sleep(0)
+            await loop.run_in_executor(waiter, lvgl.wait)
+    finally:
+        lvgl._set_coroutine_runner(None)
+        # Any use of lvgl wakes up lvgl.wait()
+        lvgl.next_task_deadline_ms()
+        waiter.shutdown(wait=False)
+
+
+def start():
+    '''
+    Start driving lvgl from the running event loop, see run()
+
+    Returns the asyncio Task; calling start() again while it is running
+    returns the same Task
+    '''
+    global _run_task
+    if _run_task is None or _run_task.done():
+        _run_task = asyncio.get_running_loop().create_task(run())
+    return _run_task
+
+
+def stop():
+    '''
+    Stop driving lvgl from the event loop
+    '''
+    global _run_task
+    if _run_task is not None:
+        _run_task.cancel()
+        _run_task = None
+
+
+def deleted(obj):
+    '''
+    Return a future which is done when the lvgl object obj is deleted
+    '''
+    loop = asyncio.get_running_loop()
+    future = loop.create_future()
+
+    def set_done():
+        if not future.done():
+            future.set_result(None)
+
+    try:
+        # The object may be deleted from another thread
+        obj.add_delete_cb(lambda obj: loop.call_soon_threadsafe(set_done))
+    except RuntimeError:
+        # the underlying C object has been deleted already
+        set_done()
+    return future
+
+
+def animations_done():
+    '''
+    Return a future which is done when no lvgl animations are running
+    '''
+    future = asyncio.get_running_loop().create_future()
+    if lvgl.anim_count_running() == 0:
+        future.set_result(None)
+    else:
+        _animation_waiters.append(future)
+    return future
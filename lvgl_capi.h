@@ -0,0 +1,37 @@
+/* C API of the lvgl Python module
+ *
+ * Allows C extensions and input threads to feed lvgl.InputDevice queues
+ * without taking the GIL or the lvgl lock:
+ *
+ *     lvgl_capi_t *capi = PyCapsule_Import(LVGL_CAPI_NAME, 0);
+ *     void *device = PyLong_AsVoidPtr(PyObject_GetAttrString(input_device, "handle"));
+ *
+ *     // from any thread, with or without the GIL
+ *     int32_t event[4] = {x, y, pressed, timestamp_ms};
+ *     capi->input_push(device, event, 1);
+ *
+ * The caller must keep a reference to the InputDevice while it pushes events.
+ */
+#ifndef LVGL_CAPI_H
+#define LVGL_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LVGL_CAPI_ATTR "_C_API"
+#define LVGL_CAPI_NAME "lvgl._C_API"
+#define LVGL_CAPI_VERSION 1
+
+typedef struct {
+    int version;
+    
+    /* Push n events of 4 int32 values (a, b, state, timestamp) onto the queue
+     * of an InputDevice (see InputDevice.handle). a and b are x and y for
+     * pointers, a is the key, button id or encoder difference otherwise.
+     * Returns the number of events queued; events which do not fit in the
+     * queue are dropped.
+     */
+    size_t (*input_push)(void *device, const int32_t *events, size_t n);
+} lvgl_capi_t;
+
+#endif
@@ -0,0 +1,17 @@
+/* Arena allocator for lvgl
+ *
+ * When the module is built with PYLV_MEM_ARENA (LVGL_MEM_ARENA=1 python
+ * setup.py build), lv_conf.h routes the lvgl heap (lv_mem_alloc and
+ * lv_mem_free) to these functions, which are implemented in lvglmodule.c,
+ * instead of the fixed LV_MEM_SIZE pool.
+ */
+#ifndef LVGL_MEM_H
+#define LVGL_MEM_H
+
+#include <stddef.h>
+
+void *pylv_mem_alloc(size_t size);
+void pylv_mem_free(void *p);
+void *pylv_mem_realloc(void *p, size_t size);
+
+#endif
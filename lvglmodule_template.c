@@ -1,6 +1,17 @@
 #include "Python.h"
 #include "structmember.h"
 #include "lvgl/lvgl.h"
+#include "lvgl/src/lv_misc/lv_gc.h"
+#include "lvgl_capi.h"
+#include "lvgl_mem.h"
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 
 #if LV_COLOR_DEPTH != 16
@@ -18,17 +29,32 @@
  *   waits for lvgl lock          process callback --> aquire GIL
  *
  * This would be a deadlock situation
+ *
+ * The lock is re-entered from callbacks (e.g. an event callback which calls
+ * an lvgl method during lvgl.poll()), so it must be recursive.
+ *
+ * The built-in lock (see lvgl_lock) is selected with lvgl.enable_threading(),
+ * and is the default on free-threaded Python builds, where there is no GIL to
+ * serialize access to lvgl. It is first tried without releasing the GIL (or
+ * detaching the thread state), which is cheap in the common re-entrant or
+ * uncontended case. Every LVGL_LOCK is a call site for the lock statistics.
  */
 
 #define LVGL_LOCK \
-    if (lock) { \
-        Py_BEGIN_ALLOW_THREADS \
-        lock(lock_arg); \
-        Py_END_ALLOW_THREADS \
+    { \
+        static lock_site_t lock_site = {__func__, __LINE__}; \
+        lvgl_lock(&lock_site); \
     }
 
 #define LVGL_UNLOCK \
-    if (unlock) { unlock(unlock_arg); }
+    lvgl_unlock();
+
+/* Release the lock after only querying lvgl, which does not count as a use of
+ * lvgl, see lvgl.wait()
+ */
+#define LVGL_UNLOCK_QUERY \
+    lock_query = true; \
+    lvgl_unlock();
  
 
 /****************************************************************
@@ -41,8 +67,6 @@
  * Forward declaration of type objects                          *
  ****************************************************************/
 
-PyObject *typesdict = NULL;
-
 <<<objects:
 static PyTypeObject pylv_{name}_Type;
 >>>
@@ -123,14 +147,283 @@ PyObject *PtrObject_fromptr(const void *ptr) {
  * Helper functons                                              *  
  ****************************************************************/
 
+#if defined(_MSC_VER)
+#define LV_THREAD_LOCAL __declspec(thread)
+#else
+#define LV_THREAD_LOCAL _Thread_local
+#endif
+
+/* Built-in recursive lvgl lock
+ *
+ * The recursion depth is kept per thread, so a thread only touches the mutex
+ * on its outermost acquire / release. The mutex is allocated once per process
+ * in lvgl_exec.
+ */
+static PyThread_type_lock rlock_mutex = NULL;
+static LV_THREAD_LOCAL int rlock_depth = 0;
+
+static void rlock_acquire(void *arg) {
+    if (rlock_depth++) return;
+    PyThread_acquire_lock(rlock_mutex, WAIT_LOCK);
+}
+
+static void rlock_release(void *arg) {
+    if (--rlock_depth) return;
+    PyThread_release_lock(rlock_mutex);
+}
+
+/* Lock statistics, per LVGL_LOCK call site
+ *
+ * Only the outermost acquisition of the built-in lock is counted. A call site
+ * is added to the lock_sites list on its first counted acquisition. All
+ * counters are updated with the lock held.
+ */
+typedef struct lock_site_t {
+    const char *func;
+    int line;
+    struct lock_site_t *next;
+    bool registered;
+    unsigned long long acquisitions;
+    unsigned long long contended;
+    int64_t wait_ns;
+    int64_t max_hold_ns;
+} lock_site_t;
+
+static lock_site_t *lock_sites = NULL;
+static bool lock_stats_enabled = false;
+static LV_THREAD_LOCAL lock_site_t *rlock_site = NULL;
+static LV_THREAD_LOCAL int64_t rlock_acquired_ns = 0;
+
+// Monotonic clock in ns
+static int64_t monotonic_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (int64_t)(count.QuadPart * (1e9 / freq.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#ifdef Py_GIL_DISABLED
+static void (*lock)(void*) = rlock_acquire;
+#else
 static void (*lock)(void*) = NULL;
+#endif
 static void* lock_arg = 0;
 
+#ifdef Py_GIL_DISABLED
+static void (*unlock)(void*) = rlock_release;
+#else
 static void (*unlock)(void*) = NULL;
+#endif
 static void* unlock_arg = 0;
 
+/* Number of sections (in any thread) entered while no lock was installed. The
+ * lock must not be installed while one is open, since that section would be
+ * left by releasing a lock it never acquired. Without a lock, the GIL
+ * protects this counter.
+ */
+static int unlocked_sections = 0;
+
+static void lvgl_lock(lock_site_t *site) {
+    bool contended = false;
+    int64_t t0 = 0;
+    
+    if (lock != rlock_acquire) {
+        if (lock) {
+            Py_BEGIN_ALLOW_THREADS
+            lock(lock_arg);
+            Py_END_ALLOW_THREADS
+        } else {
+            unlocked_sections++;
+        }
+        return;
+    }
+    
+    if (rlock_depth) {
+        rlock_depth++;
+        return;
+    }
+    
+    if (!PyThread_acquire_lock(rlock_mutex, NOWAIT_LOCK)) {
+        contended = true;
+        if (lock_stats_enabled) t0 = monotonic_ns();
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(rlock_mutex, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+    rlock_depth = 1;
+    
+    if (lock_stats_enabled) {
+        if (!site->registered) {
+            site->next = lock_sites;
+            lock_sites = site;
+            site->registered = true;
+        }
+        rlock_acquired_ns = monotonic_ns();
+        rlock_site = site;
+        site->acquisitions++;
+        if (contended) {
+            site->contended++;
+            site->wait_ns += rlock_acquired_ns - t0;
+        }
+    }
+}
+
+/* Per-binding call profile
+ *
+ * When the module is generated using 'python.py --profile', every generated
+ * method records its number of calls and the time spent parsing arguments,
+ * waiting for the lvgl lock and in the lvgl function, see
+ * lvgl.binding_profile(). The times are recorded with the lvgl lock held.
+ */
+<<BINDING_PROFILE>>
+
+typedef struct binding_profile_t {
+    const char *name; // Python method, e.g. "Btn.set_state"
+    const char *function; // lvgl function
+    unsigned long long calls;
+    uint64_t parse_ns, lock_ns, call_ns;
+    bool registered;
+    struct binding_profile_t *next;
+} binding_profile_t;
+
+static binding_profile_t *binding_profiles = NULL;
+
+static void binding_profile_record(binding_profile_t *profile, uint64_t t0, uint64_t t_parsed, uint64_t t_locked) {
+    if (!profile->registered) {
+        profile->registered = true;
+        profile->next = binding_profiles;
+        binding_profiles = profile;
+    }
+    profile->calls++;
+    profile->parse_ns += t_parsed - t0;
+    profile->lock_ns += t_locked - t_parsed;
+    profile->call_ns += monotonic_ns() - t_locked;
+}
+
+#define BINDING_PROFILE_BEGIN(name, function) \
+    static binding_profile_t binding_profile = {name, function}; \
+    uint64_t profile_t0 = monotonic_ns(), profile_t_parsed = 0, profile_t_locked = 0;
+#define BINDING_PROFILE_PARSED profile_t_parsed = monotonic_ns();
+#define BINDING_PROFILE_LOCKED profile_t_locked = monotonic_ns();
+#define BINDING_PROFILE_CALLED binding_profile_record(&binding_profile, profile_t0, profile_t_parsed, profile_t_locked);
+
+/* Atomic operations for the lock-free input queues and lvgl.wait() */
+#if defined(_MSC_VER) && !defined(__clang__)
+// volatile accesses have acquire / release semantics with /volatile:ms (the default on x86 / x64)
+#define LOAD_ACQUIRE(p) (*(volatile uint32_t *)(p))
+#define STORE_RELEASE(p, v) (*(volatile uint32_t *)(p) = (v))
+#define EXCHANGE(p, v) ((uint32_t)_InterlockedExchange((volatile long *)(p), (long)(v)))
+#else
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define EXCHANGE(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#endif
+
+/* lvgl.wait() support
+ *
+ * Any use of lvgl may have changed its state (input, invalidated areas, new
+ * tasks), so every (outermost) release of the lvgl lock is counted, and wakes
+ * up all threads blocked in lvgl.wait() (in any interpreter). The counters are
+ * only accessed with the lvgl lock held.
+ *
+ * Every waiter has its own event (a lock which is released to wake it up) in
+ * the waiters list, which is protected by waiters_mutex.
+ */
+typedef struct waiter_t {
+    PyThread_type_lock event;
+    bool woken;
+    struct waiter_t *next;
+} waiter_t;
+
+static unsigned long lock_releases = 0;
+static unsigned long lock_releases_seen = 0; // lock_releases when lvgl was last polled
+static uint32_t waiting = 0; // set when a waiter is added, cleared by the waker
+static waiter_t *waiters = NULL;
+static PyThread_type_lock waiters_mutex = NULL;
+static bool lock_query = false; // set by LVGL_UNLOCK_QUERY
+
+/* Wake up all lvgl.wait() calls; this may be called without the lvgl lock,
+ * e.g. when input is pushed
+ */
+static void wake_waiters(void) {
+    waiter_t *waiter;
+    
+    if (!EXCHANGE(&waiting, 0)) return;
+    
+    PyThread_acquire_lock(waiters_mutex, WAIT_LOCK);
+    for (waiter = waiters; waiter; waiter = waiter->next) {
+        waiter->woken = true;
+        PyThread_release_lock(waiter->event);
+    }
+    waiters = NULL;
+    PyThread_release_lock(waiters_mutex);
+}
+
+static void waiter_add(waiter_t *waiter) {
+    PyThread_acquire_lock(waiters_mutex, WAIT_LOCK);
+    waiter->woken = false;
+    waiter->next = waiters;
+    waiters = waiter;
+    EXCHANGE(&waiting, 1);
+    PyThread_release_lock(waiters_mutex);
+}
+
+/* Remove a waiter which has not been woken up (or just was) from the list.
+ * Returns whether it was woken up.
+ */
+static bool waiter_remove(waiter_t *waiter) {
+    waiter_t **p;
+    bool woken;
+    
+    PyThread_acquire_lock(waiters_mutex, WAIT_LOCK);
+    woken = waiter->woken;
+    if (!woken) {
+        for (p = &waiters; *p != waiter; p = &(*p)->next);
+        *p = waiter->next;
+        if (!waiters) EXCHANGE(&waiting, 0);
+    }
+    PyThread_release_lock(waiters_mutex);
+    return woken;
+}
+
+static void lock_released(void) {
+    if (lock_query) return; // the state of lvgl did not change
+    lock_releases++;
+    wake_waiters();
+}
+
+static void lvgl_unlock(void) {
+    int64_t hold_ns;
+    
+    if (lock != rlock_acquire) {
+        lock_released();
+        lock_query = false;
+        if (unlock) unlock(unlock_arg);
+        else unlocked_sections--;
+        return;
+    }
+    
+    if (rlock_depth == 1) {
+        lock_released();
+        if (rlock_site) {
+            hold_ns = monotonic_ns() - rlock_acquired_ns;
+            if (hold_ns > rlock_site->max_hold_ns) rlock_site->max_hold_ns = hold_ns;
+            rlock_site = NULL;
+        }
+    }
+    lock_query = false;
+    rlock_release(NULL);
+}
+
 /* 
- * This function itself is not thread-safe
+ * This function itself is not thread-safe. It replaces the built-in lock
+ * (if enabled); the lock passed must be recursive
  */
 void lv_set_lock_unlock( void (*flock)(void *), void * flock_arg, 
             void (*funlock)(void *), void * funlock_arg)
@@ -142,6 +435,535 @@ void lv_set_lock_unlock( void (*flock)(void *), void * flock_arg,
 }
 
 
+/* Frame statistics
+ *
+ * A frame is one run of lv_task_handler by lvgl.poll(). Since lvgl (and thus
+ * rendering) is shared by all interpreters, the statistics are process-global
+ * and protected by the lvgl lock. Event callbacks which run outside
+ * lvgl.poll() are accounted to the next frame.
+ */
+typedef struct {
+    uint32_t tick; // lv_tick_get() at the start of the (last) frame
+    unsigned long frames;
+    uint64_t handler_ns; // time in lv_task_handler
+    unsigned long flushes; // disp_flush calls
+    uint64_t flush_pixels;
+    uint64_t bytes_copied; // into the framebuffers
+    unsigned long inv_areas; // invalidated areas (after joining) which were refreshed
+    uint64_t inv_pixels; // refreshed pixels, as reported to monitor_cb
+    unsigned long callbacks; // Python event callbacks
+    uint64_t callback_ns; // time in Python event callbacks
+} frame_stats_t;
+
+static frame_stats_t frame_current; // the frame in progress
+static frame_stats_t frame_totals;
+static uint32_t frame_number = 1; // see disp_flush
+
+// Optional ring buffer of the last frames, see lvgl.enable_frame_history
+static frame_stats_t *frame_history = NULL;
+static size_t frame_history_size = 0, frame_history_start = 0, frame_history_len = 0;
+
+static void frame_end(uint64_t handler_ns) {
+    frame_current.frames = 1;
+    frame_current.handler_ns = handler_ns;
+    
+    frame_totals.tick = frame_current.tick;
+    frame_totals.frames++;
+    frame_totals.handler_ns += frame_current.handler_ns;
+    frame_totals.flushes += frame_current.flushes;
+    frame_totals.flush_pixels += frame_current.flush_pixels;
+    frame_totals.bytes_copied += frame_current.bytes_copied;
+    frame_totals.inv_areas += frame_current.inv_areas;
+    frame_totals.inv_pixels += frame_current.inv_pixels;
+    frame_totals.callbacks += frame_current.callbacks;
+    frame_totals.callback_ns += frame_current.callback_ns;
+    
+    if (frame_history_size) {
+        // When full, the oldest frame is overwritten
+        frame_history[(frame_history_start + frame_history_len) % frame_history_size] = frame_current;
+        if (frame_history_len < frame_history_size) {
+            frame_history_len++;
+        } else {
+            frame_history_start = (frame_history_start + 1) % frame_history_size;
+        }
+    }
+    
+    memset(&frame_current, 0, sizeof(frame_current));
+    frame_number++;
+}
+
+static PyObject *frame_stats_to_dict(const frame_stats_t *stats) {
+    return Py_BuildValue("{sIsksKsksKsKsksKsksK}",
+        "tick", stats->tick,
+        "frames", stats->frames,
+        "handler_ns", (unsigned long long) stats->handler_ns,
+        "flushes", stats->flushes,
+        "flush_pixels", (unsigned long long) stats->flush_pixels,
+        "bytes_copied", (unsigned long long) stats->bytes_copied,
+        "inv_areas", stats->inv_areas,
+        "inv_pixels", (unsigned long long) stats->inv_pixels,
+        "callbacks", stats->callbacks,
+        "callback_ns", (unsigned long long) stats->callback_ns);
+}
+
+/* Arena allocator for the lvgl heap (PYLV_MEM_ARENA, see lvgl_mem.h)
+ *
+ * Allocations of up to ARENA_MAX_SMALL bytes are rounded up to a size class
+ * and served from runs of ARENA_RUN_SIZE bytes, each holding blocks of one
+ * class. Runs are carved from chunks of PYLV_MEM_ARENA_CHUNK bytes which are
+ * mapped from the OS (mmap / VirtualAlloc). Larger allocations are mapped
+ * individually. Every run (and large allocation) is aligned to ARENA_RUN_SIZE
+ * and starts with an arena_run_t, so the run of a block is found by masking
+ * its address.
+ *
+ * Empty runs are kept for reuse by any class; chunks are never unmapped.
+ * lvgl only allocates with the lvgl lock held, which serializes the arena.
+ *
+ * lvgl.set_mem_limit() limits the bytes in use; lvgl.enable_mem_tracing()
+ * reports every allocation to tracemalloc in the MEM_TRACE_DOMAIN domain, so
+ * the lvgl heap is attributed to the Python code which caused it.
+ */
+#if PYLV_MEM_ARENA
+
+#ifndef PYLV_MEM_ARENA_CHUNK
+#define PYLV_MEM_ARENA_CHUNK (1024 * 1024)
+#endif
+
+#define ARENA_RUN_SIZE (64 * 1024) // power of 2, the Windows allocation granularity
+#define ARENA_HEADER_SIZE 64 // sizeof(arena_run_t), rounded up to keep blocks aligned
+#define ARENA_MAX_SMALL 2048
+#define ARENA_LARGE 0xff // size_class of a large allocation
+#define ARENA_PAGE_SIZE 4096
+
+typedef struct arena_run_t {
+    uint8_t size_class;
+    uint32_t used; // number of blocks in use
+    size_t size; // block size, or the mapped size of a large allocation
+    void *free; // free list of blocks
+    char *bump; // first block which was never used
+    struct arena_run_t *prev, *next; // runs of the class which have free blocks
+} arena_run_t;
+
+static const uint16_t arena_class_size[] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048};
+#define ARENA_NCLASSES (sizeof(arena_class_size) / sizeof(arena_class_size[0]))
+
+static uint8_t arena_class_of[ARENA_MAX_SMALL / 16 + 1]; // size class by (size + 15) / 16
+static arena_run_t *arena_partial[ARENA_NCLASSES];
+static arena_run_t *arena_empty = NULL; // empty runs, linked by next
+static char *arena_chunk_next = NULL, *arena_chunk_end = NULL;
+
+static size_t arena_used = 0; // bytes in allocated blocks
+static size_t arena_mapped = 0;
+static size_t arena_blocks = 0;
+static size_t arena_limit = 0; // 0: no limit
+static bool arena_trace = false;
+static bool arena_untrack = false; // set once tracing was enabled, so blocks are untracked when freed
+
+#define PYLV_MEM_TRACE_DOMAIN 0x4c56474c // 'LVGL'
+
+// Map size bytes (a multiple of ARENA_PAGE_SIZE), aligned to ARENA_RUN_SIZE
+static void *arena_map(size_t size) {
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    char *p = mmap(NULL, size + ARENA_RUN_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *aligned;
+    
+    if (p == MAP_FAILED) return NULL;
+    aligned = (char *)(((uintptr_t)p + ARENA_RUN_SIZE - 1) & ~(uintptr_t)(ARENA_RUN_SIZE - 1));
+    if (aligned > p) munmap(p, aligned - p);
+    munmap(aligned + size, p + ARENA_RUN_SIZE - aligned);
+    return aligned;
+#endif
+}
+
+static void arena_unmap(void *p, size_t size) {
+#ifdef _WIN32
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+static arena_run_t *arena_new_run(uint8_t size_class) {
+    arena_run_t *run = arena_empty;
+    
+    if (run) {
+        arena_empty = run->next;
+    } else {
+        if (arena_chunk_next == arena_chunk_end) {
+            arena_chunk_next = arena_map(PYLV_MEM_ARENA_CHUNK);
+            if (!arena_chunk_next) {
+                arena_chunk_end = NULL;
+                return NULL;
+            }
+            arena_chunk_end = arena_chunk_next + PYLV_MEM_ARENA_CHUNK;
+            arena_mapped += PYLV_MEM_ARENA_CHUNK;
+        }
+        run = (arena_run_t *) arena_chunk_next;
+        arena_chunk_next += ARENA_RUN_SIZE;
+    }
+    
+    run->size_class = size_class;
+    run->used = 0;
+    run->size = arena_class_size[size_class];
+    run->free = NULL;
+    run->bump = (char *) run + ARENA_HEADER_SIZE;
+    run->prev = NULL;
+    run->next = arena_partial[size_class];
+    if (run->next) run->next->prev = run;
+    arena_partial[size_class] = run;
+    return run;
+}
+
+static void arena_unlink(arena_run_t *run) {
+    if (run->prev) run->prev->next = run->next;
+    else arena_partial[run->size_class] = run->next;
+    if (run->next) run->next->prev = run->prev;
+}
+
+static inline arena_run_t *arena_run_of(void *p) {
+    return (arena_run_t *)((uintptr_t) p & ~(uintptr_t)(ARENA_RUN_SIZE - 1));
+}
+
+void *pylv_mem_alloc(size_t size) {
+    arena_run_t *run;
+    void *p;
+    
+    if (!arena_class_of[ARENA_MAX_SMALL / 16]) {
+        uint8_t c = 0;
+        for (size_t i = 0; i <= ARENA_MAX_SMALL / 16; i++) {
+            while (arena_class_size[c] < i * 16) c++;
+            arena_class_of[i] = c;
+        }
+    }
+    
+    if (size <= ARENA_MAX_SMALL) {
+        uint8_t size_class = arena_class_of[(size + 15) / 16];
+        
+        size = arena_class_size[size_class];
+        if (arena_limit && (arena_used + size > arena_limit)) return NULL;
+        
+        run = arena_partial[size_class];
+        if (!run && !(run = arena_new_run(size_class))) return NULL;
+        
+        if (run->free) {
+            p = run->free;
+            run->free = *(void **) p;
+        } else {
+            p = run->bump;
+            run->bump += size;
+        }
+        run->used++;
+        // Full: no free blocks, and no room for another block
+        if (!run->free && ((size_t)(run->bump - (char *) run) + size > ARENA_RUN_SIZE)) {
+            arena_unlink(run);
+            run->prev = run->next = NULL;
+        }
+    } else {
+        size_t mapped = (ARENA_HEADER_SIZE + size + ARENA_PAGE_SIZE - 1) & ~(size_t)(ARENA_PAGE_SIZE - 1);
+        
+        if (arena_limit && (arena_used + size > arena_limit)) return NULL;
+        run = arena_map(mapped);
+        if (!run) return NULL;
+        run->size_class = ARENA_LARGE;
+        run->used = 1;
+        run->size = mapped;
+        arena_mapped += mapped;
+        p = (char *) run + ARENA_HEADER_SIZE;
+        size = mapped - ARENA_HEADER_SIZE;
+    }
+    
+    arena_used += size;
+    arena_blocks++;
+    if (arena_trace) PyTraceMalloc_Track(PYLV_MEM_TRACE_DOMAIN, (uintptr_t) p, size);
+    return p;
+}
+
+void pylv_mem_free(void *p) {
+    arena_run_t *run;
+    
+    if (!p) return;
+    if (arena_untrack) PyTraceMalloc_Untrack(PYLV_MEM_TRACE_DOMAIN, (uintptr_t) p);
+    arena_blocks--;
+    
+    run = arena_run_of(p);
+    if (run->size_class == ARENA_LARGE) {
+        arena_used -= run->size - ARENA_HEADER_SIZE;
+        arena_mapped -= run->size;
+        arena_unmap(run, run->size);
+        return;
+    }
+    
+    arena_used -= run->size;
+    if (!run->free && ((size_t)(run->bump - (char *) run) + run->size > ARENA_RUN_SIZE)) {
+        // Was full: make it available again
+        run->prev = NULL;
+        run->next = arena_partial[run->size_class];
+        if (run->next) run->next->prev = run;
+        arena_partial[run->size_class] = run;
+    }
+    *(void **) p = run->free;
+    run->free = p;
+    
+    // Keep one partial run per class, to avoid releasing and re-initializing
+    // a run when a single block is allocated and freed repeatedly
+    if (!--run->used && (run->prev || run->next)) {
+        arena_unlink(run);
+        run->next = arena_empty;
+        arena_empty = run;
+    }
+}
+
+void *pylv_mem_realloc(void *p, size_t size) {
+    arena_run_t *run;
+    size_t old_size;
+    void *new_p;
+    
+    if (!p) return pylv_mem_alloc(size);
+    
+    run = arena_run_of(p);
+    old_size = (run->size_class == ARENA_LARGE) ? run->size - ARENA_HEADER_SIZE : run->size;
+    if ((size <= old_size) && (size > old_size / 2)) return p;
+    
+    new_p = pylv_mem_alloc(size);
+    if (!new_p) return NULL;
+    memcpy(new_p, p, size < old_size ? size : old_size);
+    pylv_mem_free(p);
+    return new_p;
+}
+
+#endif
+
+/* lvgl heap accounting
+ *
+ * lvgl fails badly when its heap (LV_MEM_SIZE) is exhausted: most functions
+ * halt in lv_mem_assert. The peak usage of the heap is sampled after every
+ * frame and by lvgl.mem_info(). Allocation failures are counted through the
+ * lvgl log.
+ *
+ * When a reserve is set (lvgl.set_mem_reserve), generated methods and object
+ * constructors raise MemoryError instead of calling lvgl when the biggest
+ * free block is smaller than the reserve.
+ */
+static uint32_t mem_peak_used = 0;
+static unsigned long mem_alloc_failures = 0;
+static uint32_t mem_reserve = 0;
+
+// Must be called with the lvgl lock held
+static void mem_sample(lv_mem_monitor_t *mon) {
+#if PYLV_MEM_ARENA
+    // The arena grows on demand, so only a limit bounds the free space
+    size_t total = arena_limit ? arena_limit : arena_mapped;
+    size_t used = arena_used < total ? arena_used : total;
+    
+    memset(mon, 0, sizeof(*mon));
+    mon->total_size = total > UINT32_MAX ? UINT32_MAX : total;
+    mon->free_size = mon->total_size - (used > UINT32_MAX ? UINT32_MAX : used);
+    mon->free_biggest_size = arena_limit ? mon->free_size : UINT32_MAX;
+    mon->used_cnt = arena_blocks;
+    mon->used_pct = total ? used * 100 / total : 0;
+    mon->frag_pct = arena_mapped ? (arena_mapped - (arena_used < arena_mapped ? arena_used : arena_mapped)) * 100 / arena_mapped : 0;
+#else
+    lv_mem_monitor(mon);
+#endif
+    if (mon->total_size - mon->free_size > mem_peak_used) mem_peak_used = mon->total_size - mon->free_size;
+}
+
+static int check_mem_reserve(void) {
+    lv_mem_monitor_t mon;
+    
+    LVGL_LOCK
+    mem_sample(&mon);
+    LVGL_UNLOCK
+    
+    if (mon.free_biggest_size < mem_reserve) {
+        PyErr_Format(PyExc_MemoryError, "lvgl heap low: biggest free block is %u bytes, reserve is %u bytes",
+            (unsigned int) mon.free_biggest_size, (unsigned int) mem_reserve);
+        return -1;
+    }
+    return 0;
+}
+
+/* Return -1 (with MemoryError set) if the lvgl heap is below the reserve */
+static inline int check_mem(void) {
+    return mem_reserve ? check_mem_reserve() : 0;
+}
+
+#if LV_USE_LOG
+static void log_cb(lv_log_level_t level, const char *file, uint32_t line, const char *dsc) {
+    // lv_mem_alloc / lv_mem_realloc: "Couldn't allocate memory"
+    if (strstr(dsc, "allocate memory")) mem_alloc_failures++;
+}
+#endif
+
+/* Input queue
+ *
+ * A lock-free ring buffer of input events. The consumer (indev_read, with the
+ * lvgl lock held) only writes tail; producers only write head, and are
+ * serialized by a spin lock, so that input threads can push without taking
+ * the GIL or the lvgl lock (see lvgl_capi.h).
+ *
+ * indev_read returns one event per call, and returns true while more events
+ * are buffered, so lvgl processes all intermediate samples. When the queue is
+ * empty, the last event is repeated.
+ *
+ * The timestamp (in ms) is not used by lvgl, it is only kept with the event
+ */
+#define INPUT_QUEUE_SIZE 256 // must be a power of 2
+
+typedef struct {
+    lv_indev_data_t data;
+    uint32_t timestamp;
+} input_event_t;
+
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    input_event_t events[INPUT_QUEUE_SIZE];
+    lv_indev_data_t last; // last event read
+    uint32_t last_read_tick; // lv_tick_get() when the last event was read
+    unsigned long dropped; // number of events dropped since the queue was full
+    uint32_t push_lock; // serializes producers
+} input_queue_t;
+
+static void input_queue_lock(input_queue_t *queue) {
+    while (EXCHANGE(&queue->push_lock, 1)) {
+        while (LOAD_ACQUIRE(&queue->push_lock)); // wait until it appears free
+    }
+}
+
+static void input_queue_unlock(input_queue_t *queue) {
+    STORE_RELEASE(&queue->push_lock, 0);
+}
+
+// Returns false (and drops the event) if the queue is full; must be called
+// with the push lock held
+static bool input_queue_push(input_queue_t *queue, const input_event_t *event) {
+    uint32_t head = queue->head;
+    
+    if (head - LOAD_ACQUIRE(&queue->tail) >= INPUT_QUEUE_SIZE) {
+        queue->dropped++;
+        return false;
+    }
+    queue->events[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+    STORE_RELEASE(&queue->head, head + 1);
+    return true;
+}
+
+// Returns true if more events are buffered
+static bool input_queue_pop(input_queue_t *queue, lv_indev_data_t *data) {
+    uint32_t tail = queue->tail;
+    uint32_t head = LOAD_ACQUIRE(&queue->head);
+    
+    if (tail != head) {
+        queue->last = queue->events[tail & (INPUT_QUEUE_SIZE - 1)].data;
+        queue->last_read_tick = lv_tick_get();
+        STORE_RELEASE(&queue->tail, ++tail);
+    }
+    *data = queue->last;
+    // the state carries over to the next read while the queue is empty, a
+    // relative encoder step must not
+    queue->last.enc_diff = 0;
+    return tail != head;
+}
+
+static bool input_queue_empty(input_queue_t *queue) {
+    return LOAD_ACQUIRE(&queue->head) == queue->tail;
+}
+
+/* Input device, wrapped by an lvgl.InputDevice object */
+typedef struct {
+    lv_indev_drv_t driver;
+    lv_indev_t *indev;
+    input_queue_t queue;
+    lv_point_t *button_points; // for LV_INDEV_TYPE_BUTTON
+    uint16_t id; // identifies the device in input recordings
+} input_dev_t;
+
+typedef struct {
+    PyObject_HEAD
+    input_dev_t dev;
+    PyObject *group; // Group of a keypad or encoder
+} InputDeviceObject;
+
+/* Module state
+ *
+ * lvgl itself has process-global state (the object tree, the task list and
+ * the memory pool), so lv_init is called only once per process. Every module
+ * instance (one per (sub)interpreter which imports lvgl) registers its own
+ * display with its own framebuffer, and its own input device. Since all
+ * instances share lvgl, rendering is serialized by the lvgl lock.
+ */
+
+typedef struct {
+    PyInterpreterState *interp;
+    PyObject *struct_dict;
+    
+    lv_disp_t *disp;
+    lv_disp_drv_t display_driver;
+    lv_disp_buf_t disp_buffer;
+    lv_color_t disp_buf1[1024 * 10];
+    char framebuffer[LV_HOR_RES_MAX * LV_VER_RES_MAX * 2];
+    
+    PyObject *input[LV_INDEV_TYPE_ENCODER + 1]; // InputDevice used by the module functions, per lv_indev_type_t
+    
+    uint32_t inv_counted_frame; // frame_number of the last frame in which the invalidated areas were counted
+    
+    PyObject *coroutine_runner; // set by lvgl.aio, see run_coroutine
+    
+    PyObject *theme; // the Theme applied last
+    PyObject *themes; // Themes made by set_theme, by (name, hue, font)
+    
+    PyObject *scr_act; // the screen loaded by scr_load
+} lvgl_state;
+
+static int lvgl_initialized = 0;
+
+/* Static types cannot find their module (PyType_GetModule only works for heap
+ * types), so the module is stored in the interpreter dict when it is executed.
+ *
+ * Returns a borrowed pointer, or NULL with an exception set
+ */
+static lvgl_state *get_state(void) {
+    PyObject *interp_dict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // borrowed reference
+    PyObject *module = interp_dict ? PyDict_GetItemString(interp_dict, "lvgl.module") : NULL; // borrowed reference
+    
+    if (!module) {
+        PyErr_SetString(PyExc_RuntimeError, "lvgl is not initialized in this interpreter");
+        return NULL;
+    }
+    return PyModule_GetState(module);
+}
+
+/* lvgl callbacks may be called while another interpreter is active, e.g.
+ * lvgl.poll() in one interpreter deletes an object which was created from
+ * another interpreter. Python objects may only be used from the interpreter
+ * they belong to, so switch to a thread state of that interpreter.
+ *
+ * Returns the thread state to pass to interp_leave, or NULL if no switch was
+ * required
+ */
+static PyThreadState *interp_enter(PyInterpreterState *interp) {
+    PyThreadState *prev = PyThreadState_Get();
+    
+    if (!interp || PyThreadState_GetInterpreter(prev) == interp) return NULL;
+    
+    PyThreadState_Swap(PyThreadState_New(interp));
+    return prev;
+}
+
+static void interp_leave(PyThreadState *prev) {
+    PyThreadState *tstate;
+    
+    if (!prev) return;
+    
+    tstate = PyThreadState_Swap(prev);
+    PyThreadState_Clear(tstate);
+    PyThreadState_Delete(tstate);
+}
+
+
 
 /* This signal handler is critical in the deallocation process of lvgl and
  * associated Python objects. It is called when an lvgl object is deleted either
@@ -161,6 +983,84 @@ void lv_set_lock_unlock( void (*flock)(void *), void * flock_arg,
  * (the case that there never was a Python object for this lvgl object cannot
  * happen, since then this signal handler was never installed)
  */
+/* Call the callbacks registered with Obj.add_delete_cb, with the object as
+ * argument
+ */
+static void call_delete_cbs(pylv_Obj * py_obj)
+{
+    PyObject *delete_cbs = py_obj->delete_cbs;
+    PyObject *result;
+    
+    if (!delete_cbs) return;
+    py_obj->delete_cbs = NULL;
+    
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(delete_cbs); i++) {
+        result = PyObject_CallFunctionObjArgs(PyList_GET_ITEM(delete_cbs, i), py_obj, NULL);
+        if (result) {
+            Py_DECREF(result);
+        } else {
+            PyErr_Print();
+            PyErr_Clear();
+        }
+    }
+    Py_DECREF(delete_cbs);
+}
+
+/* Release the Python object of a deleted lvgl object: call its delete
+ * callbacks, release the event callback (which cannot be called anymore;
+ * this also breaks reference cycles of the object and its callback) and
+ * the reference which lvgl held
+ */
+static void obj_release(pylv_Obj *py_obj) {
+    call_delete_cbs(py_obj);
+    Py_CLEAR(py_obj->event_cb);
+    if (py_obj->owned) {
+        // a screen owned by Python: lvgl did not hold a reference
+        py_obj->owned = false;
+    } else {
+        Py_DECREF(py_obj);
+    }
+}
+
+/* During obj_delete_tree, the Python objects of the deleted lvgl objects are
+ * collected in a batch, and released after lv_obj_del has returned
+ */
+typedef struct {
+    pylv_Obj **items;
+    size_t len;
+    size_t size;
+} delete_batch_t;
+
+static delete_batch_t *delete_batch; // set by obj_delete_tree, with the lvgl lock held
+
+/* Returns false if there is no batch (or no memory), then the caller releases
+ * the object immediately
+ */
+static bool delete_batch_add(pylv_Obj *py_obj) {
+    pylv_Obj **items;
+    size_t size;
+    
+    if (!delete_batch) return false;
+    if (delete_batch->len == delete_batch->size) {
+        size = delete_batch->size ? delete_batch->size * 2 : 64;
+        items = PyMem_RawRealloc(delete_batch->items, size * sizeof(pylv_Obj *));
+        if (!items) return false;
+        delete_batch->items = items;
+        delete_batch->size = size;
+    }
+    if (py_obj->owned) {
+        // keep it alive until it is released
+        py_obj->owned = false;
+        Py_INCREF(py_obj);
+    }
+    delete_batch->items[delete_batch->len++] = py_obj;
+    return true;
+}
+
+#if LV_USE_ANIMATION
+static void anim_obj_deleted(lv_obj_t *obj);
+#endif
+
 static lv_res_t pylv_signal_cb(lv_obj_t * obj, lv_signal_t sign, void * param)
 {
     pylv_Obj* py_obj = (pylv_Obj*)(*lv_obj_get_user_data_ptr(obj));
@@ -180,7 +1080,12 @@ static lv_res_t pylv_signal_cb(lv_obj_t * obj, lv_signal_t sign, void * param)
             
             // remove reference to Python object
             (*lv_obj_get_user_data_ptr(obj)) = NULL;
-            Py_DECREF(py_obj); 
+            PyThreadState *prev = interp_enter(py_obj->interp);
+#if LV_USE_ANIMATION
+            anim_obj_deleted(obj);
+#endif
+            if (!delete_batch_add(py_obj)) obj_release(py_obj);
+            interp_leave(prev);
         }
 
     }
@@ -200,18 +1105,189 @@ static void install_signal_cb(pylv_Obj * py_obj) {
     lv_obj_set_signal_cb(py_obj->ref, pylv_signal_cb);
 }
 
-
-
-/* Given an lvgl lv_obj, return the accompanying Python object. If the 
- * accompanying object already exists, it is returned (with ref count increased).
- * If the lv_obj is not yet known to Python, a new Python object is created,
- * with the appropriate type (which is determined using lv_obj_get_type and the
- * typesdict dictionary of lv_obj_type name (string) --> Python Type
+/* Ownership and garbage collection of objects
  *
- * Returns a new reference
+ * lvgl holds a reference to the Python object of each of its objects (in
+ * user_data), which is released by pylv_signal_cb when the object is deleted.
+ * The exception is a screen created from Python: it is owned by its Python
+ * object, so when the last Python reference to the screen is dropped, the
+ * screen and all its children are deleted in one lv_obj_del call (see
+ * Obj_finalize). lvgl.scr_load keeps a reference to the loaded screen.
+ *
+ * The references which lvgl holds to the Python objects of the children of
+ * an owned screen are reported to the garbage collector by the screen's
+ * tp_traverse. So a screen which is only referenced from the callbacks of
+ * its own objects is garbage, and deleted by the collector.
  */
-
-PyObject * pyobj_from_lv(lv_obj_t *obj) {
+static int Obj_traverse_children(lv_obj_t *obj, PyInterpreterState *interp, visitproc visit, void *arg) {
+    lv_obj_t *child = NULL;
+    pylv_Obj *py_child;
+    int ret;
+    
+    while ((child = lv_obj_get_child(obj, child)) != NULL) {
+        py_child = *lv_obj_get_user_data_ptr(child);
+        // Objects of other interpreters are not known to this collector
+        if (py_child && !py_child->owned && (py_child->interp == interp)) Py_VISIT(py_child);
+        ret = Obj_traverse_children(child, interp, visit, arg);
+        if (ret) return ret;
+    }
+    return 0;
+}
+
+static int Obj_traverse(pylv_Obj *self, visitproc visit, void *arg) {
+    Py_VISIT(self->event_cb);
+    Py_VISIT(self->delete_cbs);
+    if (self->owned && self->ref) return Obj_traverse_children(self->ref, self->interp, visit, arg);
+    return 0;
+}
+
+static int Obj_clear(pylv_Obj *self) {
+    Py_CLEAR(self->event_cb);
+    Py_CLEAR(self->delete_cbs);
+    return 0;
+}
+
+/* True if obj is the loaded screen of its display; must be called with the
+ * lvgl lock held
+ */
+static bool obj_is_loaded(lv_obj_t *obj) {
+    return !lv_obj_get_parent(obj) && (lv_disp_get_scr_act(lv_obj_get_disp(obj)) == obj);
+}
+
+/* The cost of deleting object trees, see obj_delete_tree */
+typedef struct {
+    unsigned long trees;
+    unsigned long objects; // lvgl objects deleted
+    unsigned long wrappers; // Python objects released
+    uint64_t lvgl_ns; // in lv_obj_del
+    uint64_t release_ns; // releasing the Python objects
+} teardown_stats_t;
+
+static unsigned long obj_count_tree(lv_obj_t *obj) {
+    lv_obj_t *child = NULL;
+    unsigned long n = 1;
+    
+    while ((child = lv_obj_get_child(obj, child)) != NULL) n += obj_count_tree(child);
+    return n;
+}
+
+/* Delete obj and its children in one lv_obj_del call. The Python objects are
+ * released in one batch afterwards, instead of one by one from within lvgl.
+ * The cost is added to stats (if not NULL)
+ */
+static void obj_delete_tree(lv_obj_t *obj, teardown_stats_t *stats) {
+    delete_batch_t batch = {NULL, 0, 0}, *prev_batch;
+    unsigned long objects;
+    int64_t t0, t1, t2;
+    
+    LVGL_LOCK
+    objects = obj_count_tree(obj);
+    t0 = monotonic_ns();
+    // lv_obj_del may run Python code (LV_EVENT_DELETE), which may delete
+    // another tree
+    prev_batch = delete_batch;
+    delete_batch = &batch;
+    lv_obj_del(obj);
+    delete_batch = prev_batch;
+    LVGL_UNLOCK
+    
+    t1 = monotonic_ns();
+    for (size_t i = 0; i < batch.len; i++) {
+        PyThreadState *prev = interp_enter(batch.items[i]->interp);
+        obj_release(batch.items[i]);
+        interp_leave(prev);
+    }
+    PyMem_RawFree(batch.items);
+    t2 = monotonic_ns();
+    
+    if (stats) {
+        stats->trees++;
+        stats->objects += objects;
+        stats->wrappers += batch.len;
+        stats->lvgl_ns += t1 - t0;
+        stats->release_ns += t2 - t1;
+    }
+}
+
+static PyObject *teardown_stats_dict(const teardown_stats_t *stats) {
+    return Py_BuildValue("{sksksksKsK}",
+        "trees", stats->trees,
+        "objects", stats->objects,
+        "wrappers", stats->wrappers,
+        "lvgl_ns", (unsigned long long) stats->lvgl_ns,
+        "release_ns", (unsigned long long) stats->release_ns);
+}
+
+static void Obj_finalize(pylv_Obj *self) {
+    PyObject *exc_type, *exc_value, *exc_tb;
+    bool loaded;
+    
+    if (!self->owned || !self->ref) return;
+    
+    PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+    LVGL_LOCK
+    loaded = obj_is_loaded(self->ref);
+    if (loaded) {
+        // The screen is shown, which happens when the module state (with the
+        // reference of scr_load) is cleared: leave it to lvgl, like any
+        // other object, and lvgl_free
+        self->owned = false;
+        Py_INCREF(self);
+    }
+    LVGL_UNLOCK
+    if (!loaded) obj_delete_tree(self->ref, NULL);
+    PyErr_Restore(exc_type, exc_value, exc_tb);
+}
+
+
+
+/* Table of lv_obj_type name (string) --> Python Type, used by pyobj_from_lv
+ * to find the Python type for an lvgl object
+ */
+static const struct {
+    const char *lv_name;
+    PyTypeObject *type;
+} objtypes[] = {
+<<<objects:
+    {{"lv_{name}", &pylv_{name}_Type}},>>>
+    {NULL, NULL}
+};
+
+static PyTypeObject *objtype_from_lv(const char *lv_name) {
+    for (int i=0; objtypes[i].lv_name; i++) {
+        if (strcmp(objtypes[i].lv_name, lv_name) == 0) return objtypes[i].type;
+    }
+    return NULL;
+}
+
+/* Given an lvgl lv_obj, return the accompanying Python object. If the 
+ * accompanying object already exists, it is returned (with ref count increased).
+ * If the lv_obj is not yet known to Python, a new Python object is created,
+ * with the appropriate type (which is determined using lv_obj_get_type and the
+ * objtypes table of lv_obj_type name (string) --> Python Type
+ *
+ * Returns a new reference
+ *
+ * With the GIL, the user_data back-pointer cannot change while this function
+ * runs. Without it, two threads could both create a Python object for the same
+ * lv_obj, so the lookup and creation is done with the lvgl lock held.
+ */
+
+static PyObject * pyobj_from_lv_locked(lv_obj_t *obj);
+
+PyObject * pyobj_from_lv(lv_obj_t *obj) {
+#ifdef Py_GIL_DISABLED
+    PyObject *ret;
+    LVGL_LOCK
+    ret = pyobj_from_lv_locked(obj);
+    LVGL_UNLOCK
+    return ret;
+#else
+    return pyobj_from_lv_locked(obj);
+#endif
+}
+
+static PyObject * pyobj_from_lv_locked(lv_obj_t *obj) {
     pylv_Obj *pyobj;
     lv_obj_type_t objtype;
     const char *objtype_str;
@@ -230,15 +1306,17 @@ PyObject * pyobj_from_lv(lv_obj_t *obj) {
         lv_obj_get_type(obj, &objtype);
         objtype_str = objtype.type[0];
         if (objtype_str) {
-            tp = (PyTypeObject *)PyDict_GetItemString(typesdict, objtype_str); // borrowed reference
+            tp = objtype_from_lv(objtype_str);
         }
-        if (!tp) tp = &pylv_obj_Type; // Default to Obj (should not happen; lv_obj_get_type failed or result not found in typesdict)
+        if (!tp) tp = &pylv_obj_Type; // Default to Obj (should not happen; lv_obj_get_type failed or result not found in objtypes)
+
+        // Types are readied on first use, see module_getattr
+        if (PyType_Ready(tp) < 0) return NULL;
 
-        pyobj = PyObject_Malloc(tp->tp_basicsize);
+        pyobj = (pylv_Obj *) tp->tp_alloc(tp, 0);
         if (!pyobj) return NULL;
-        memset(pyobj, 0, tp->tp_basicsize);
-        PyObject_Init((PyObject *)pyobj, tp);
         pyobj -> ref = obj;
+        pyobj -> interp = PyInterpreterState_Get();
         *lv_obj_get_user_data_ptr(obj) = pyobj;
         install_signal_cb(pyobj);
         // reference count for pyobj is 1 -- the reference stored in the lvgl object user_data
@@ -256,19 +1334,28 @@ PyObject * pyobj_from_lv(lv_obj_t *obj) {
  * associated Python object, i.e. the global ones and those
  * created from Python
  *
- * The module global struct_dict dictionary stores all struct
+ * The struct_dict dictionary of the module state stores all struct
  * objects known
  */
- 
-static PyObject* struct_dict;
 
 static PyObject *pystruct_from_lv(const void *c_struct) {
     PyObject *ret;
     PyObject *ptr;
+    lvgl_state *state = get_state();
+    if (!state) return NULL;
+    
     ptr = PtrObject_fromptr(c_struct);
     if (!ptr) return NULL;
     
-    ret = PyDict_GetItem(struct_dict, ptr);
+#if PY_VERSION_HEX >= 0x030D0000
+    // A borrowed reference is unsafe without the GIL: another thread could
+    // replace the dict entry
+    if (PyDict_GetItemRef(state->struct_dict, ptr, &ret) == 0) {
+        PyErr_SetString(PyExc_RuntimeError, "the returned C struct is unknown to Python");
+    }
+    Py_DECREF(ptr);
+#else
+    ret = PyDict_GetItem(state->struct_dict, ptr);
     Py_DECREF(ptr);
 
     if (ret) {
@@ -276,12 +1363,169 @@ static PyObject *pystruct_from_lv(const void *c_struct) {
     } else {
         PyErr_SetString(PyExc_RuntimeError, "the returned C struct is unknown to Python");
     }
+#endif
     return ret;
 }
 
 
+/****************************************************************
+ * Free lists                                                   *
+ ****************************************************************/
+
+/* The Python objects of lvgl objects and of structs are created and released
+ * in large numbers, e.g. when building and deleting screens, or by accessing
+ * style.body.radius (which creates a struct object for style.body). Instead
+ * of returning their memory to the Python allocator, up to size freed
+ * objects are kept on a free list and reused.
+ *
+ * Only objects of the static types (not of Python subclasses) are kept, and
+ * only in the main interpreter, since the memory of one interpreter may not
+ * be used by another. Free-threaded builds do not use the free lists. The
+ * freed objects are linked through the first field after PyObject_HEAD.
+ */
+typedef struct {
+    PyObject *head;
+    Py_ssize_t len;
+    Py_ssize_t size;
+    unsigned long long hits; // allocations from the free list
+    unsigned long long misses; // allocations from the Python allocator
+    unsigned long long releases; // freed to the Python allocator since the free list was full
+} freelist_t;
+
+#define FREELIST_NEXT(op) (*(PyObject **) ((op) + 1))
+
+static freelist_t obj_freelist = {NULL, 0, 256};
+static freelist_t struct_freelist = {NULL, 0, 256};
+
+static bool freelist_eligible(PyTypeObject *tp, Py_ssize_t basicsize) {
+#ifdef Py_GIL_DISABLED
+    return false;
+#else
+    return (tp->tp_basicsize == basicsize) && !(tp->tp_flags & Py_TPFLAGS_HEAPTYPE) &&
+        (PyInterpreterState_Get() == PyInterpreterState_Main());
+#endif
+}
+
+static PyObject *freelist_pop(freelist_t *fl) {
+    PyObject *op = fl->head;
+    
+    if (!op) {
+        fl->misses++;
+        return NULL;
+    }
+    fl->head = FREELIST_NEXT(op);
+    fl->len--;
+    fl->hits++;
+    return op;
+}
+
+static bool freelist_push(freelist_t *fl, PyObject *op) {
+    if (fl->len >= fl->size) {
+        fl->releases++;
+        return false;
+    }
+    FREELIST_NEXT(op) = fl->head;
+    fl->head = op;
+    fl->len++;
+    return true;
+}
+
+/* Free objects from the free list until at most size are left */
+static void freelist_trim(freelist_t *fl, Py_ssize_t size, void (*release)(void *)) {
+    PyObject *op;
+    
+    while (fl->len > size) {
+        op = fl->head;
+        fl->head = FREELIST_NEXT(op);
+        fl->len--;
+        release(op);
+    }
+}
+
+/* tp_alloc and tp_free of the object types */
+static PyObject *
+Obj_alloc(PyTypeObject *tp, Py_ssize_t nitems) {
+    PyObject *op;
+    
+    if (nitems || !freelist_eligible(tp, sizeof(pylv_Obj)) || !(op = freelist_pop(&obj_freelist))) {
+        return PyType_GenericAlloc(tp, nitems);
+    }
+    memset(op, 0, sizeof(pylv_Obj));
+    PyObject_Init(op, tp);
+    PyObject_GC_Track(op);
+    return op;
+}
+
+static void
+Obj_free(void *p) {
+    PyObject *op = p;
+    
+    // A finalized object (a screen owned by Python, or an object collected as
+    // part of a reference cycle) cannot be reused, since the finalizer is
+    // only called once for its memory
+    if (!freelist_eligible(Py_TYPE(op), sizeof(pylv_Obj)) || PyObject_GC_IsFinalized(op) || !freelist_push(&obj_freelist, op)) {
+        PyObject_GC_Del(p);
+    }
+}
 
+static PyObject *freelist_dict(const freelist_t *fl) {
+    return Py_BuildValue("{snsnsKsKsK}",
+        "size", fl->size,
+        "free", fl->len,
+        "hits", fl->hits,
+        "misses", fl->misses,
+        "releases", fl->releases);
+}
+
+/* lvgl.freelist_info(reset=False): statistics of the free lists of object
+ * and struct objects
+ */
+static PyObject *
+freelist_info(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    
+    ret = Py_BuildValue("{sNsN}",
+        "objects", freelist_dict(&obj_freelist),
+        "structs", freelist_dict(&struct_freelist));
+    if (ret && reset) {
+        obj_freelist.hits = obj_freelist.misses = obj_freelist.releases = 0;
+        struct_freelist.hits = struct_freelist.misses = struct_freelist.releases = 0;
+    }
+    return ret;
+}
 
+/* lvgl.set_freelist_size(objects=None, structs=None): set the maximum number
+ * of freed objects kept for reuse; 0 disables a free list
+ */
+static PyObject *
+set_freelist_size(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"objects", "structs", NULL};
+    PyObject *objects = Py_None, *structs = Py_None;
+    Py_ssize_t obj_size = obj_freelist.size, struct_size = struct_freelist.size;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO", kwlist, &objects, &structs)) {
+        return NULL;
+    }
+    if ((objects != Py_None) && (((obj_size = PyLong_AsSsize_t(objects)) == -1) && PyErr_Occurred())) return NULL;
+    if ((structs != Py_None) && (((struct_size = PyLong_AsSsize_t(structs)) == -1) && PyErr_Occurred())) return NULL;
+    if ((obj_size < 0) || (struct_size < 0)) {
+        PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+        return NULL;
+    }
+    
+    obj_freelist.size = obj_size;
+    freelist_trim(&obj_freelist, obj_size, PyObject_GC_Del);
+    struct_freelist.size = struct_size;
+    freelist_trim(&struct_freelist, struct_size, PyObject_Free);
+    
+    Py_RETURN_NONE;
+}
 
 
 /****************************************************************
@@ -312,6 +1556,27 @@ Struct_dealloc(StructObject *self)
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
+/* tp_alloc and tp_free of the struct types, see Free lists */
+static PyObject *
+Struct_alloc(PyTypeObject *tp, Py_ssize_t nitems) {
+    PyObject *op;
+    
+    if (nitems || (tp->tp_flags & Py_TPFLAGS_HAVE_GC) || !freelist_eligible(tp, sizeof(StructObject)) || !(op = freelist_pop(&struct_freelist))) {
+        return PyType_GenericAlloc(tp, nitems);
+    }
+    memset(op, 0, sizeof(StructObject));
+    return PyObject_Init(op, tp);
+}
+
+static void
+Struct_free(void *p) {
+    PyObject *op = p;
+    
+    if (!freelist_eligible(Py_TYPE(op), sizeof(StructObject)) || !freelist_push(&struct_freelist, op)) {
+        PyObject_Free(p);
+    }
+}
+
 // Provide a read-write buffer to the binary data in this struct
 static int Struct_getbuffer(PyObject *exporter, Py_buffer *view, int flags) {
     StructObject *self = (StructObject*)exporter;
@@ -323,7 +1588,7 @@ static PyBufferProcs Struct_bufferprocs = {
     NULL,
 };
 
-// Register a Struct object in the global struct_dict dictionary, such that if
+// Register a Struct object in the struct_dict dictionary, such that if
 // a C function returns a pointer to the C struct, the associated Python object
 // can be returned
 //
@@ -334,11 +1599,14 @@ static PyBufferProcs Struct_bufferprocs = {
 // returns 0 on success, -1 on error with exception set
 static int Struct_register(StructObject *obj) {
     PyObject *ptr_pyobj;
+    lvgl_state *state = get_state();
+    if (!state) return -1;
+    
     ptr_pyobj = PtrObject_fromptr(obj->data);
 
     if (!ptr_pyobj) return -1;
     
-    if (PyDict_SetItem(struct_dict, ptr_pyobj, (PyObject*) obj)) { // todo: use weak references
+    if (PyDict_SetItem(state->struct_dict, ptr_pyobj, (PyObject*) obj)) { // todo: use weak references
         Py_DECREF(ptr_pyobj);
         return -1;
     }
@@ -354,7 +1622,8 @@ static PyObject *
 pystruct_from_c(PyTypeObject *type, const void* ptr, size_t size, bool copy) {
     StructObject *ret = 0;
 
-    ret = (StructObject*)PyObject_New(StructObject, type);
+    if (PyType_Ready(type) < 0) return NULL;
+    ret = (StructObject*)Struct_alloc(type, 0);
     if (!ret) return NULL;
 
     if (copy) {
@@ -453,7 +1722,8 @@ typedef struct {
 static PyObject *
 struct_get_struct(StructObject *self, struct_closure_t *closure) {
     StructObject *ret;    
-    ret = (StructObject*)PyObject_New(StructObject, closure->type);
+    if (PyType_Ready(closure->type) < 0) return NULL;
+    ret = (StructObject*)Struct_alloc(closure->type, 0);
     if (ret) {
         ret->owner = self->owner;
         if (self->owner) Py_INCREF(self->owner); // owner could be NULL if data is C global
@@ -525,6 +1795,40 @@ struct_set_struct(StructObject *self, PyObject *value, struct_closure_t *closure
 }
 
 
+/* struct member getter/setter for font pointers, e.g. style.text.font: a
+ * font_t (a built-in font or an lvgl.Font), or None for NULL
+ */
+static PyObject *
+struct_get_font(StructObject *self, void *closure)
+{
+    const lv_font_t *font = *(const lv_font_t **)((char*)self->data + (int)closure);
+    PyObject *ret;
+    
+    if (!font) Py_RETURN_NONE;
+    ret = pystruct_from_lv(font);
+    if (!ret && PyErr_ExceptionMatches(PyExc_RuntimeError)) {
+        // A built-in font which was not yet accessed from Python
+        PyErr_Clear();
+        ret = pystruct_from_c(&pylv_font_t_Type, font, sizeof(lv_font_t), 0);
+    }
+    return ret;
+}
+
+static int
+struct_set_font(StructObject *self, PyObject *value, void *closure)
+{
+    if (struct_check_readonly(self)) return -1;
+    if ((value != Py_None) && !PyObject_TypeCheck(value, &pylv_font_t_Type)) {
+        PyErr_Format(PyExc_TypeError, "value should be a font_t or None, not %.200s", Py_TYPE(value)->tp_name);
+        return -1;
+    }
+    
+    // font_t objects are registered in struct_dict, which keeps them alive
+    *(const lv_font_t **)((char*)self->data + (int)closure) = (value == Py_None) ? NULL : (const lv_font_t *) ((StructObject *) value)->data;
+    return 0;
+}
+
+
 static int
 struct_init(StructObject *self, PyObject *args, PyObject *kwds, PyTypeObject *type, size_t size) 
 {
@@ -578,6 +1882,8 @@ static PyTypeObject pylv_{name}_Type = {{
     .tp_itemsize = 0,
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
     .tp_new = PyType_GenericNew,
+    .tp_alloc = Struct_alloc,
+    .tp_free = Struct_free,
     .tp_init = (initproc) pylv_{name}_init,
     .tp_dealloc = (destructor) Struct_dealloc,
     .tp_getset = pylv_{name}_getset,
@@ -616,6 +1922,8 @@ static PyTypeObject pylv_{name}_Type = {{
     .tp_itemsize = 0,
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
     .tp_new = NULL, // sub structs cannot be instantiated
+    .tp_alloc = Struct_alloc,
+    .tp_free = Struct_free,
     .tp_dealloc = (destructor) Struct_dealloc,
     .tp_getset = pylv_{name}_getset,
     .tp_repr = (reprfunc) Struct_repr,
@@ -628,73 +1936,119 @@ static PyTypeObject pylv_{name}_Type = {{
  * Custom types: constclass                                     *  
  ****************************************************************/
 
-static PyType_Slot constclass_slots[] = {
-    {0, 0},
+/* C enum constants are exposed as enum.IntEnum (or enum.IntFlag for enums of
+ * bit flags) subclasses, built from a static table of name / value pairs.
+ * 
+ * Symbols and colors are exposed as a static, immutable class which has the
+ * constants as class attributes.
+ */
+
+typedef struct {
+    const char *name;
+    long value;
+} enum_item_t;
+
+static PyObject* build_enumclass(const char *name, const enum_item_t *items, bool flag) {
+    PyObject *enum_module = NULL, *enumtype = NULL, *members = NULL, *member = NULL;
+    PyObject *args = NULL, *kwds = NULL, *enumclass = NULL;
+    
+    enum_module = PyImport_ImportModule("enum");
+    if (!enum_module) goto error;
+    enumtype = PyObject_GetAttrString(enum_module, flag ? "IntFlag" : "IntEnum");
+    if (!enumtype) goto error;
+    
+    members = PyList_New(0);
+    if (!members) goto error;
+    
+    for (; items->name; items++) {
+        member = Py_BuildValue("(sl)", items->name, items->value);
+        if (!member) goto error;
+        if (PyList_Append(members, member)) goto error;
+        Py_CLEAR(member);
+    }
+    
+    args = Py_BuildValue("(sO)", name, members);
+    kwds = Py_BuildValue("{ss}", "module", "lvgl");
+    if (!args || !kwds) goto error;
+    
+    // e.g. IntEnum("ALIGN", [("CENTER", 0), ...], module="lvgl")
+    enumclass = PyObject_Call(enumtype, args, kwds);
+    
+error:
+    Py_XDECREF(enum_module);
+    Py_XDECREF(enumtype);
+    Py_XDECREF(members);
+    Py_XDECREF(member);
+    Py_XDECREF(args);
+    Py_XDECREF(kwds);
+    return enumclass;
+}
+
+static PyTypeObject SYMBOL_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.SYMBOL",
+    .tp_doc = "lvgl symbols",
+    .tp_basicsize = sizeof(PyObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = NULL, // cannot be instantiated
+};
+
+static PyTypeObject COLOR_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.COLOR",
+    .tp_doc = "lvgl colors",
+    .tp_basicsize = sizeof(PyObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = NULL, // cannot be instantiated
 };
 
-/* Create a new class which represents a set of constants
- * Used for C enum constants, symbols and colors
+/* Fill in a class which represents a set of constants
+ * Used for symbols and colors
  *
- * variadic arguments are char* name, <type> value, ... , NULL
- * representing the enum values
+ * names is a NULL-terminated array of constant names, values is an array of
+ * the same length with the values
  *
- * dtype: 'd' for integers, 's' for strings, 'C' for colors (lv_color_t)
+ * dtype: 's' for strings (const char * values), 'C' for colors (lv_color_t values)
  *
  */
-static PyObject* build_constclass(char dtype, char *name, ...) {
+static PyObject* build_constclass(PyTypeObject *type, char dtype, const char * const *names, const void *values) {
 
-    va_list args;
-    va_start(args, name);
-
-    PyType_Spec spec = {
-        .name = name,
-        .basicsize = sizeof(PyObject),
-        .itemsize = 0,
-        .flags = Py_TPFLAGS_DEFAULT,
-        .slots = constclass_slots /* terminated by slot==0. */
-    };
-    
-    PyObject *constclass_type = PyType_FromSpec(&spec);
-    if (!constclass_type) return NULL;
+    if (PyType_Ready(type) < 0) return NULL;
     
-    ((PyTypeObject*)constclass_type)->tp_new = NULL; // objects cannot be instantiated
-    
-    while(1) {
-        char *name = va_arg(args, char*);
-        if (!name) break;
-        
+    for (int i=0; names[i]; i++) {
         PyObject *value=NULL;
-        lv_color_t color;
         
         switch(dtype) {
-            case 'd':
-                value = PyLong_FromLong(va_arg(args, int));
-                break;
             case 's':
-                value = PyUnicode_FromString(va_arg(args, char *));
+                value = PyUnicode_FromString(((const char * const *)values)[i]);
                 break;
             case 'C':
-                color = va_arg(args, lv_color_t);
-                value = pystruct_from_c(&<<LV_COLOR_TYPE>>, &color, sizeof(lv_color_t), 1);
+                value = pystruct_from_c(&<<LV_COLOR_TYPE>>, &((const lv_color_t *)values)[i], sizeof(lv_color_t), 1);
                 break;
             default:
                 assert(0);
         }
         
-        if (!value) goto error;
+        if (!value) return NULL;
         
-        PyObject_SetAttrString(constclass_type, name, value);
+        // Static types cannot be modified from Python, so write into the type
+        // dict directly
+        if (PyDict_SetItemString(type->tp_dict, names[i], value)) {
+            Py_DECREF(value);
+            return NULL;
+        }
         Py_DECREF(value);
     }
+    PyType_Modified(type);
 
-    return constclass_type;
-
-error:
-    Py_DECREF(constclass_type);
-    return NULL;
-
+    Py_INCREF(type);
+    return (PyObject *) type;
 }
 
+<<ENUM_TABLES>>
+<<SYMBOL_BUILDER>>
+<<COLOR_BUILDER>>
+
 
 /****************************************************************
  * Custom method implementations                                *
@@ -766,11 +2120,44 @@ error:
     return NULL;
 }
 
+/* Event callbacks may be coroutine functions. The coroutine is handed to the
+ * runner installed by lvgl.aio, which schedules it on the asyncio event loop
+ * so that it does not block rendering.
+ *
+ * Steals the reference to coro
+ */
+static PyObject *run_coroutine(PyObject *coro) {
+    lvgl_state *state = get_state();
+    PyObject *ret = NULL;
+    
+    if (state && state->coroutine_runner) {
+        ret = PyObject_CallFunctionObjArgs(state->coroutine_runner, coro, NULL);
+    } else if (state) {
+        // close the coroutine to prevent a 'never awaited' warning
+        ret = PyObject_CallMethod(coro, "close", NULL);
+        Py_XDECREF(ret);
+        ret = NULL;
+        PyErr_SetString(PyExc_RuntimeError, "coroutine event callbacks require lvgl.aio to be running");
+    }
+    Py_DECREF(coro);
+    return ret;
+}
+
 void pylv_event_cb(lv_obj_t *obj, lv_event_t event) {
     pylv_Obj *self = (pylv_Obj *)*lv_obj_get_user_data_ptr(obj);
-    assert(self && self->event_cb);
     
-    PyObject *result = PyObject_CallFunction(self->event_cb, "I", event);
+    // event_cb is cleared by the garbage collector before the owning screen
+    // is deleted
+    if (!self || !self->event_cb) return;
+    
+    PyThreadState *prev = interp_enter(self->interp);
+    uint64_t t0 = monotonic_ns();
+    // The callback may replace itself using set_event_cb, keep it alive
+    PyObject *event_cb = self->event_cb;
+    Py_INCREF(event_cb);
+    PyObject *result = PyObject_CallFunction(event_cb, "I", event);
+    Py_DECREF(event_cb);
+    if (result && PyCoro_CheckExact(result)) result = run_coroutine(result);
     
     if (result) {
         Py_DECREF(result);
@@ -778,6 +2165,9 @@ void pylv_event_cb(lv_obj_t *obj, lv_event_t event) {
         PyErr_Print();
         PyErr_Clear();
     }
+    frame_current.callbacks++;
+    frame_current.callback_ns += monotonic_ns() - t0;
+    interp_leave(prev);
     
 }
 
@@ -788,19 +2178,64 @@ pylv_obj_set_event_cb(pylv_Obj *self, PyObject *args, PyObject *kwds) {
     PyObject *callback, *old_callback;
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &callback)) return NULL;
     
-    old_callback = self->event_cb;
-    self->event_cb = callback;
     Py_INCREF(callback);
-    Py_XDECREF(old_callback);
     
+    // Swap the callback with the lock held, since pylv_event_cb may be
+    // reading it from another thread
     LVGL_LOCK
+    old_callback = self->event_cb;
+    self->event_cb = callback;
     lv_obj_set_event_cb(self->ref, pylv_event_cb);
     LVGL_UNLOCK
     
+    Py_XDECREF(old_callback);
+    
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+pylv_obj_add_delete_cb(pylv_Obj *self, PyObject *args, PyObject *kwds) {
+    if (check_alive(self)) return NULL;
+    static char *kwlist[] = {"delete_cb", NULL};
+    PyObject *callback;
+    int err = -1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &callback)) return NULL;
+    
+    // The callbacks are called and released by pylv_signal_cb
+    LVGL_LOCK
+    if (!self->delete_cbs) self->delete_cbs = PyList_New(0);
+    if (self->delete_cbs) err = PyList_Append(self->delete_cbs, callback);
+    LVGL_UNLOCK
     
+    if (err) return NULL;
     Py_RETURN_NONE;
 }
 
+/* Obj.delete_tree(): delete the object and its children natively, releasing
+ * their Python objects in one batch afterwards. Returns the cost, see
+ * teardown_stats_dict
+ */
+static PyObject *
+pylv_obj_delete_tree(pylv_Obj *self, PyObject *args, PyObject *kwds) {
+    if (check_alive(self)) return NULL;
+    static char *kwlist[] = {NULL};
+    teardown_stats_t stats = {0};
+    bool loaded;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) return NULL;
+    
+    LVGL_LOCK
+    loaded = obj_is_loaded(self->ref);
+    LVGL_UNLOCK
+    if (loaded) {
+        PyErr_SetString(PyExc_RuntimeError, "cannot delete the loaded screen");
+        return NULL;
+    }
+    
+    obj_delete_tree(self->ref, &stats);
+    return teardown_stats_dict(&stats);
+}
+
 static PyObject*
 pylv_label_get_letter_pos(pylv_Label *self, PyObject *args, PyObject *kwds)
 {
@@ -882,7 +2317,7 @@ pylv_list_focus(pylv_List *self, PyObject *args, PyObject *kwds)
     if (parent) parent = lv_obj_get_parent(parent); // get the obj's parent's parent in a safe way
     
     if (parent != self->ref) {
-        if (unlock) unlock(unlock_arg);
+        LVGL_UNLOCK
         return PyErr_Format(PyExc_RuntimeError, "%R is not a child of %R", obj, self);
     }
     
@@ -906,11 +2341,18 @@ pylv_{name}_dealloc(pylv_{pyname} *self)
 
     // the accompanying lv_obj holds a reference to the Python object, so
     // dealloc can only take place if the lv_obj has already been deleted using
-    // Obj.del_() or .clean() on ints parents. 
+    // Obj.del_() or .clean() on ints parents, or if it is a screen owned by
+    // Python, which Obj_finalize deletes
+    //
+    // Only owned screens need the finalizer; not calling it for other objects
+    // keeps their memory reusable, see Obj_free
+    if (self->owned && self->ref && (PyObject_CallFinalizerFromDealloc((PyObject *) self) < 0)) return; // resurrected
+    PyObject_GC_UnTrack(self);
     
     if (self->weakreflist != NULL)
         PyObject_ClearWeakRefs((PyObject *) self);
-
+    
+    Obj_clear((pylv_Obj *) self);
     Py_TYPE(self)->tp_free((PyObject *) self);
 
 }}
@@ -921,15 +2363,30 @@ pylv_{name}_init(pylv_{pyname} *self, PyObject *args, PyObject *kwds)
     static char *kwlist[] = {{"parent", "copy", NULL}};
     pylv_Obj *parent=NULL;
     pylv_{pyname} *copy=NULL;
+    lvgl_state *state=NULL;
     
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O!O!", kwlist, &pylv_obj_Type, &parent, &pylv_{name}_Type, &copy)) {{
         return -1;
     }}   
     
+    if (!parent) {{
+        // A new screen is created on the display of this interpreter
+        state = get_state();
+        if (!state) return -1;
+    }}
+    
+    if (check_mem()) return -1;
+    
     LVGL_LOCK
+    if (state) lv_disp_set_default(state->disp);
     self->ref = lv_{name}_create(parent ? parent->ref : NULL, copy ? copy->ref : NULL);
+    self->interp = PyInterpreterState_Get();
     *lv_obj_get_user_data_ptr(self->ref) = self;
-    Py_INCREF(self); // since reference is stored in lv_obj user data
+    if (parent) {{
+        Py_INCREF(self); // since reference is stored in lv_obj user data
+    }} else {{
+        self->owned = true; // a screen is owned by this Python object, see Obj_finalize
+    }}
     install_signal_cb(self);
     LVGL_UNLOCK
 
@@ -948,10 +2405,16 @@ static PyTypeObject pylv_{name}_Type = {{
     .tp_doc = "lvgl {pyname}",
     .tp_basicsize = sizeof(pylv_{pyname}),
     .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_base = {base},
     .tp_new = PyType_GenericNew,
+    .tp_alloc = Obj_alloc,
+    .tp_free = Obj_free,
     .tp_init = (initproc) pylv_{name}_init,
     .tp_dealloc = (destructor) pylv_{name}_dealloc,
+    .tp_traverse = (traverseproc) Obj_traverse,
+    .tp_clear = (inquiry) Obj_clear,
+    .tp_finalize = (destructor) Obj_finalize,
     .tp_methods = pylv_{name}_methods,
     .tp_weaklistoffset = offsetof(pylv_{pyname}, weakreflist),
 }};
@@ -964,11 +2427,28 @@ static PyTypeObject pylv_{name}_Type = {{
  * Miscellaneous functions                                      *
  ****************************************************************/
 
+/* Load scr and keep it alive; the previous one is deleted if it is owned by
+ * Python and no longer referenced
+ */
+static void scr_load(lvgl_state *state, pylv_Obj *scr) {
+    PyObject *prev;
+    
+    LVGL_LOCK
+    lv_scr_load(scr->ref);
+    LVGL_UNLOCK
+    
+    prev = state->scr_act;
+    Py_INCREF(scr);
+    state->scr_act = (PyObject *) scr;
+    Py_XDECREF(prev);
+}
+
 static PyObject *
 pylv_scr_act(PyObject *self, PyObject *args) {
+    lvgl_state *state = PyModule_GetState(self);
     lv_obj_t *scr;
     LVGL_LOCK
-    scr = lv_scr_act();
+    scr = lv_disp_get_scr_act(state->disp);
     LVGL_UNLOCK
     return pyobj_from_lv(scr);
 }
@@ -976,87 +2456,5023 @@ pylv_scr_act(PyObject *self, PyObject *args) {
 static PyObject *
 pylv_scr_load(PyObject *self, PyObject *args, PyObject *kwds) {
     static char *kwlist[] = {"scr", NULL};
+    lvgl_state *state = PyModule_GetState(self);
     pylv_Obj *scr;
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!", kwlist, &pylv_obj_Type, &scr)) return NULL;
-    LVGL_LOCK
-    lv_scr_load(scr->ref);
-    LVGL_UNLOCK
+    if (check_alive(scr)) return NULL;
     
+    scr_load(state, scr);
     Py_RETURN_NONE;
 }
 
 
+static uint32_t task_deadline_ms(void);
+
+/* Run the lvgl tasks which are due. Returns the time in ms until the next
+ * task is due (see next_task_deadline_ms)
+ */
 static PyObject *
-poll(PyObject *self, PyObject *args) {
-    LVGL_LOCK
-    lv_tick_inc(1);
-    lv_task_handler();
-    LVGL_UNLOCK
+poll(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"elapsed_ms", NULL};
+    unsigned int elapsed_ms = 1;
+    uint32_t deadline;
+    uint64_t t0;
+    lv_mem_monitor_t mon;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|I", kwlist, &elapsed_ms)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    lv_tick_inc(elapsed_ms);
+    frame_current.tick = lv_tick_get();
+    t0 = monotonic_ns();
+    lv_task_handler();
+    frame_end(monotonic_ns() - t0);
+    mem_sample(&mon);
+    deadline = task_deadline_ms();
+    lock_releases_seen = lock_releases + 1; // including the release below
+    LVGL_UNLOCK
+    
+    if (deadline == UINT32_MAX) Py_RETURN_NONE;
+    return PyLong_FromUnsignedLong(deadline);
+}
+
+/* Tasks created by lv_init, i.e. the animation task */
+#define MAX_CORE_TASKS 4
+static lv_task_t *core_tasks[MAX_CORE_TASKS];
+static int n_core_tasks = 0;
+
+// Idle input devices are read for a while after the last input, e.g. to
+// finish a drag throw
+#define INDEV_IDLE_MS 1000
+
+static bool indev_read(struct _lv_indev_drv_t * indev_drv, lv_indev_data_t *data);
+
+/* Return true if running the task now would have no effect, such that it can
+ * be left out of the deadline:
+ *   - the refresh task of a display without invalidated areas
+ *   - the read task of an input device of a module instance, while released
+ *     and without new input
+ *   - the animation task, while no animations are running
+ */
+static bool task_is_idle(lv_task_t *task) {
+    lv_disp_t *disp;
+    lv_indev_t *indev;
+    input_dev_t *dev;
+    
+    for (disp = lv_disp_get_next(NULL); disp; disp = lv_disp_get_next(disp)) {
+        if (task == disp->refr_task) return disp->inv_p == 0;
+    }
+    
+    for (indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+        if ((task != indev->driver.read_task) || (indev->driver.read_cb != indev_read)) continue;
+        
+        dev = indev->driver.user_data;
+        return !dev || ((dev->queue.last.state == LV_INDEV_STATE_REL) && input_queue_empty(&dev->queue) && 
+                    (lv_tick_elaps(dev->queue.last_read_tick) > INDEV_IDLE_MS));
+    }
+    
+#if LV_USE_ANIMATION
+    for (int i = 0; i < n_core_tasks; i++) {
+        if (task == core_tasks[i]) return lv_anim_count_running() == 0;
+    }
+#endif
+
+    return false;
+}
+
+/* Time in ms until the first lv_task is due, 0 if a task is due already or
+ * UINT32_MAX if there are no tasks. Idle tasks (see task_is_idle) are not
+ * taken into account. Must be called with the lvgl lock held
+ */
+static uint32_t task_deadline_ms(void) {
+    uint32_t deadline = UINT32_MAX;
+    uint32_t elapsed;
+    lv_task_t *task;
+    
+    for (task = lv_ll_get_head(&LV_GC_ROOT(_lv_task_ll)); task; task = lv_ll_get_next(&LV_GC_ROOT(_lv_task_ll), task)) {
+        if (task->prio == LV_TASK_PRIO_OFF) continue;
+        if (task_is_idle(task)) continue;
+        
+        elapsed = lv_tick_elaps(task->last_run);
+        if (elapsed >= task->period) return 0;
+        if (task->period - elapsed < deadline) deadline = task->period - elapsed;
+    }
+    return deadline;
+}
+
+static PyObject *
+next_task_deadline_ms(PyObject *self, PyObject *args) {
+    uint32_t deadline;
+    
+    LVGL_LOCK
+    deadline = task_deadline_ms();
+    LVGL_UNLOCK
+    
+    if (deadline == UINT32_MAX) Py_RETURN_NONE;
+    return PyLong_FromUnsignedLong(deadline);
+}
+
+/* Block until lvgl needs to be polled: when the next task is due, or lvgl is
+ * used (e.g. input is sent, or an object is changed) from another thread, or
+ * the timeout (in s, None = no timeout) expires.
+ *
+ * Returns True if woken up by the use of lvgl, False otherwise
+ */
+static PyObject *
+lvgl_wait(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout", NULL};
+    PyObject *timeout_obj = Py_None;
+    double timeout_us = -1;
+    uint32_t deadline;
+    PyLockStatus r = PY_LOCK_FAILURE;
+    bool woken;
+    waiter_t waiter;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &timeout_obj)) {
+        return NULL;
+    }
+    if (timeout_obj != Py_None) {
+        timeout_us = PyFloat_AsDouble(timeout_obj) * 1e6;
+        if (PyErr_Occurred()) return NULL;
+        if (timeout_us < 0) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be non-negative");
+            return NULL;
+        }
+    }
+    
+    waiter.event = PyThread_allocate_lock();
+    if (!waiter.event) return PyErr_NoMemory();
+    PyThread_acquire_lock(waiter.event, WAIT_LOCK);
+    
+    LVGL_LOCK
+    /* Add the waiter before the deadline is determined: input may be pushed
+     * without the lvgl lock, either before the deadline sees it, or after,
+     * waking us up
+     */
+    waiter_add(&waiter);
+    deadline = task_deadline_ms();
+    woken = lock_releases != lock_releases_seen; // lvgl was used since it was polled
+    if (woken && waiter_remove(&waiter)) {
+        // consume a wakeup by input pushed meanwhile
+        PyThread_acquire_lock(waiter.event, WAIT_LOCK);
+    }
+    LVGL_UNLOCK_QUERY // this release does not wake up other waiters
+    
+    if (woken) {
+        PyThread_release_lock(waiter.event);
+        PyThread_free_lock(waiter.event);
+        Py_RETURN_TRUE;
+    }
+    
+    if ((deadline != UINT32_MAX) && ((timeout_us < 0) || (deadline * 1e3 < timeout_us))) {
+        timeout_us = deadline * 1e3;
+    }
+    if (timeout_us > PY_TIMEOUT_MAX) timeout_us = PY_TIMEOUT_MAX;
+    
+    Py_BEGIN_ALLOW_THREADS
+    r = PyThread_acquire_lock_timed(waiter.event, (PY_TIMEOUT_T) timeout_us, 1);
+    Py_END_ALLOW_THREADS
+    
+    woken = (r == PY_LOCK_ACQUIRED);
+    if (!woken && waiter_remove(&waiter)) {
+        // a wakeup raced with the timeout; consume it
+        woken = PyThread_acquire_lock(waiter.event, WAIT_LOCK);
+    }
+    PyThread_release_lock(waiter.event); // locked again in all cases
+    PyThread_free_lock(waiter.event);
+    
+    if ((r == PY_LOCK_INTR) && PyErr_CheckSignals()) return NULL;
+    
+    return PyBool_FromLong(woken);
+}
+
+static PyObject *
+anim_count_running(PyObject *self, PyObject *args) {
+    long count = 0;
+    
+#if LV_USE_ANIMATION
+    LVGL_LOCK
+    count = lv_anim_count_running();
+    LVGL_UNLOCK_QUERY // lvgl.aio calls this between poll() and wait()
+#endif
+
+    return PyLong_FromLong(count);
+}
+
+static PyObject *
+set_coroutine_runner(PyObject *self, PyObject *runner) {
+    lvgl_state *state = PyModule_GetState(self);
+    PyObject *old_runner = state->coroutine_runner;
+    
+    if (runner == Py_None) {
+        state->coroutine_runner = NULL;
+    } else {
+        Py_INCREF(runner);
+        state->coroutine_runner = runner;
+    }
+    Py_XDECREF(old_runner);
+    
+    Py_RETURN_NONE;
+}
+
+
+/* TODO: all the framebuffer display driver stuff could be separated (i.e. do not default to it but allow user to register custom frame buffer driver) */
+
+/* disp_flush should copy from the VDB (virtual display buffer to the screen.
+ * In our case, we copy to the framebuffer of the module state
+ */
+
+ 
+static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p) {
+    lvgl_state *state = disp_drv->user_data;
+    if (!state) {
+        // the module instance of this display has been freed
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+    
+    char *dest = state->framebuffer + ((area->y1)*LV_HOR_RES_MAX + area->x1) * 2;
+    char *src = (char *) color_p;
+
+    for(int32_t y = area->y1; y<=area->y2; y++) {
+        memcpy(dest, src, 2*(area->x2-area->x1+1));
+        src += 2*(area->x2-area->x1+1);
+        dest += 2*LV_HOR_RES_MAX;
+    }
+    
+    uint32_t pixels = lv_area_get_size(area);
+    frame_current.flushes++;
+    frame_current.flush_pixels += pixels;
+    frame_current.bytes_copied += pixels * 2;
+    
+    // The invalidated areas are only cleared after the whole refresh, so they
+    // are counted at the first flush (the display is refreshed once per frame)
+    if (state->inv_counted_frame != frame_number) {
+        state->inv_counted_frame = frame_number;
+        for (int i = 0; i < state->disp->inv_p; i++) {
+            if (!state->disp->inv_area_joined[i]) frame_current.inv_areas++;
+        }
+    }
+    
+    lv_disp_flush_ready(disp_drv);
+}
+
+// Called by lvgl after every refresh of the display
+static void disp_monitor(lv_disp_drv_t * disp_drv, uint32_t time, uint32_t px) {
+    frame_current.inv_pixels += px;
+}
+
+static void input_record(input_dev_t *dev, const lv_indev_data_t *data);
+static bool input_recording = false;
+
+static bool indev_read(struct _lv_indev_drv_t * indev_drv, lv_indev_data_t *data) {
+    input_dev_t *dev = indev_drv->user_data;
+    bool fresh, more;
+    
+    if (!dev) {
+        // the InputDevice of this input device has been deallocated
+        data->state = LV_INDEV_STATE_REL;
+        return false;
+    }
+    
+    fresh = !input_queue_empty(&dev->queue);
+    more = input_queue_pop(&dev->queue, data);
+    if (fresh && input_recording) input_record(dev, data);
+    
+    return more;
+}
+
+/* Convert (a, b, state, timestamp) to an input event. a and b are x and y
+ * for pointers, a is the key, button id or encoder difference otherwise
+ */
+static void input_event_init(input_event_t *event, lv_indev_type_t type, int32_t a, int32_t b, int32_t state, uint32_t timestamp) {
+    memset(event, 0, sizeof(*event));
+    switch (type) {
+        case LV_INDEV_TYPE_POINTER:
+            event->data.point.x = a;
+            event->data.point.y = b;
+            break;
+        case LV_INDEV_TYPE_KEYPAD:
+            event->data.key = a;
+            break;
+        case LV_INDEV_TYPE_BUTTON:
+            event->data.btn_id = a;
+            break;
+        case LV_INDEV_TYPE_ENCODER:
+            event->data.enc_diff = a;
+            break;
+        default:
+            break;
+    }
+    event->data.state = state ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+    event->timestamp = timestamp;
+}
+
+/* Push n events of 4 int32 values (a, b, state, timestamp) onto the queue of
+ * the input device, and wake up lvgl.wait(). Does not require the GIL or the
+ * lvgl lock. Returns the number of events queued; events which do not fit
+ * are dropped
+ */
+static size_t input_dev_push(void *device, const int32_t *events, size_t n) {
+    input_dev_t *dev = device;
+    input_event_t event;
+    size_t queued = 0;
+    
+    input_queue_lock(&dev->queue);
+    for (size_t i = 0; i < n; i++, events += 4) {
+        input_event_init(&event, dev->driver.type, events[0], events[1], events[2], events[3]);
+        if (input_queue_push(&dev->queue, &event)) queued++;
+    }
+    input_queue_unlock(&dev->queue);
+    
+    if (queued) wake_waiters();
+    return queued;
+}
+
+/* Whether a buffer format is a single integer in native byte order (e.g. "i",
+ * or "<i" as used by ctypes on little-endian machines); the item size must be
+ * checked separately, since it depends on sizeof(long)
+ */
+static bool format_is_int32(const char *format) {
+    if (!format) return false; // unsigned bytes
+    if ((*format == '@') || (*format == '=') || (*format == (PY_LITTLE_ENDIAN ? '<' : '>'))) format++;
+    return format[0] && strchr("iIlL", format[0]) && !format[1];
+}
+
+/* Push events onto the queue of the input device. events is either a buffer
+ * of int32 values (e.g. an array.array('i')), 4 per event, or a sequence of
+ * 4-tuples: (a, b, state, timestamp), see input_event_init
+ *
+ * Returns the number of events queued, or -1 on error
+ */
+static Py_ssize_t push_input_events(input_dev_t *dev, PyObject *events) {
+    Py_buffer view;
+    Py_ssize_t n, queued;
+    PyObject *seq;
+    int32_t *values;
+    
+    if (PyObject_CheckBuffer(events)) {
+        if (PyObject_GetBuffer(events, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) return -1;
+        if ((view.itemsize != 4) || !format_is_int32(view.format) || (view.len % 16)) {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "events buffer should consist of int32 values, 4 per event");
+            return -1;
+        }
+        
+        // Other threads may run while a large batch is copied
+        Py_BEGIN_ALLOW_THREADS
+        queued = input_dev_push(dev, view.buf, view.len / 16);
+        Py_END_ALLOW_THREADS
+        
+        PyBuffer_Release(&view);
+        return queued;
+    }
+    
+    seq = PySequence_Fast(events, "events should be a buffer or a sequence of (a, b, state, timestamp) tuples");
+    if (!seq) return -1;
+    
+    n = PySequence_Fast_GET_SIZE(seq);
+    values = PyMem_Malloc(sizeof(int32_t) * 4 * (n ? n : 1));
+    if (!values) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        int a, b, state;
+        unsigned int timestamp;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "iiiI", &a, &b, &state, &timestamp)) {
+            PyMem_Free(values);
+            Py_DECREF(seq);
+            return -1;
+        }
+        values[4 * i] = a;
+        values[4 * i + 1] = b;
+        values[4 * i + 2] = state;
+        values[4 * i + 3] = timestamp;
+    }
+    Py_DECREF(seq);
+    
+    queued = input_dev_push(dev, values, n);
+    PyMem_Free(values);
+    return queued;
+}
+
+
+/****************************************************************
+ *  InputDevice                                                 *
+ ****************************************************************/
+
+/* lvgl.InputDevice(type=INDEV_TYPE.POINTER): an input device of the display
+ * of this interpreter, with its own event queue.
+ *
+ * lvgl cannot unregister an input device, so when an InputDevice is
+ * deallocated, its input device is retired: its read task is stopped and it
+ * is no longer read.
+ */
+
+static PyTypeObject InputDevice_Type;
+
+#if LV_USE_GROUP
+static PyObject *InputDevice_set_group(InputDeviceObject *self, PyObject *args, PyObject *kwds);
+static PyObject *InputDevice_get_group(InputDeviceObject *self, void *closure);
+#endif
+
+static int
+InputDevice_init(InputDeviceObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"type", NULL};
+    input_dev_t *dev = &self->dev;
+    lvgl_state *state = get_state();
+    long type = LV_INDEV_TYPE_POINTER;
+    
+    if (!state) return -1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|l", kwlist, &type)) {
+        return -1;
+    }
+    if ((type <= LV_INDEV_TYPE_NONE) || (type > LV_INDEV_TYPE_ENCODER)) {
+        PyErr_Format(PyExc_ValueError, "invalid input device type %ld", type);
+        return -1;
+    }
+    if (dev->indev) {
+        PyErr_SetString(PyExc_RuntimeError, "InputDevice is already initialized");
+        return -1;
+    }
+    
+    lv_indev_drv_init(&dev->driver);
+    dev->driver.type = type;
+    dev->driver.read_cb = indev_read;
+    dev->driver.user_data = dev;
+    dev->driver.disp = state->disp;
+    LVGL_LOCK
+    static uint16_t next_id = 0;
+    dev->id = next_id++;
+    dev->indev = lv_indev_drv_register(&dev->driver);
+    LVGL_UNLOCK
+    
+    if (!dev->indev) {
+        PyErr_SetString(PyExc_RuntimeError, "failed to register the input device");
+        return -1;
+    }
+    return 0;
+}
+
+static void
+InputDevice_dealloc(InputDeviceObject *self) {
+    input_dev_t *dev = &self->dev;
+    
+    if (dev->indev) {
+        LVGL_LOCK
+        lv_task_set_prio(dev->indev->driver.read_task, LV_TASK_PRIO_OFF);
+        dev->indev->driver.user_data = NULL;
+        lv_indev_set_button_points(dev->indev, NULL);
+#if LV_USE_GROUP
+        lv_indev_set_group(dev->indev, NULL);
+#endif
+        LVGL_UNLOCK
+    }
+    PyMem_Free(dev->button_points);
+    Py_XDECREF(self->group);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static input_dev_t *
+InputDevice_get(InputDeviceObject *self) {
+    if (!self->dev.indev) {
+        PyErr_SetString(PyExc_RuntimeError, "InputDevice is not initialized");
+        return NULL;
+    }
+    return &self->dev;
+}
+
+static PyObject *
+InputDevice_push(InputDeviceObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"a", "b", "pressed", NULL};
+    input_dev_t *dev = InputDevice_get(self);
+    int32_t event[4] = {0};
+    int a, b = 0, pressed = 0;
+    
+    if (!dev) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|ip", kwlist, &a, &b, &pressed)) {
+        return NULL;
+    }
+    event[0] = a;
+    event[1] = b;
+    event[2] = pressed;
+    event[3] = lv_tick_get();
+    
+    return PyBool_FromLong(input_dev_push(dev, event, 1));
+}
+
+static PyObject *
+InputDevice_push_events(InputDeviceObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"events", NULL};
+    input_dev_t *dev = InputDevice_get(self);
+    PyObject *events;
+    Py_ssize_t queued;
+    
+    if (!dev) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &events)) {
+        return NULL;
+    }
+    
+    queued = push_input_events(dev, events);
+    if (queued < 0) return NULL;
+    return PyLong_FromSsize_t(queued);
+}
+
+/* Set the screen points which are pressed by the buttons of a button input
+ * device; points is a sequence of (x, y) tuples, indexed by button id
+ */
+static PyObject *
+InputDevice_set_button_points(InputDeviceObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"points", NULL};
+    input_dev_t *dev = InputDevice_get(self);
+    PyObject *points, *seq;
+    lv_point_t *button_points, *old_button_points;
+    int x, y;
+    
+    if (!dev) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &points)) {
+        return NULL;
+    }
+    
+    seq = PySequence_Fast(points, "points should be a sequence of (x, y) tuples");
+    if (!seq) return NULL;
+    
+    button_points = PyMem_Malloc(sizeof(lv_point_t) * (PySequence_Fast_GET_SIZE(seq) + 1));
+    if (!button_points) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "ii", &x, &y)) {
+            PyMem_Free(button_points);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        button_points[i].x = x;
+        button_points[i].y = y;
+    }
+    Py_DECREF(seq);
+    
+    // lvgl keeps a reference to the points
+    LVGL_LOCK
+    old_button_points = dev->button_points;
+    dev->button_points = button_points;
+    lv_indev_set_button_points(dev->indev, button_points);
+    LVGL_UNLOCK
+    
+    PyMem_Free(old_button_points);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+InputDevice_get_type(InputDeviceObject *self, void *closure) {
+    return PyLong_FromLong(self->dev.driver.type);
+}
+
+static PyObject *
+InputDevice_get_id(InputDeviceObject *self, void *closure) {
+    return PyLong_FromLong(self->dev.id);
+}
+
+static PyObject *
+InputDevice_get_pending(InputDeviceObject *self, void *closure) {
+    return PyLong_FromUnsignedLong(LOAD_ACQUIRE(&self->dev.queue.head) - LOAD_ACQUIRE(&self->dev.queue.tail));
+}
+
+static PyObject *
+InputDevice_get_dropped(InputDeviceObject *self, void *closure) {
+    return PyLong_FromUnsignedLong(self->dev.queue.dropped);
+}
+
+// Handle for input_push of the C API, see lvgl_capi.h
+static PyObject *
+InputDevice_get_handle(InputDeviceObject *self, void *closure) {
+    input_dev_t *dev = InputDevice_get(self);
+    if (!dev) return NULL;
+    return PyLong_FromVoidPtr(dev);
+}
+
+static PyMethodDef InputDevice_methods[] = {
+    {"push", (PyCFunction) InputDevice_push, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"push_events", (PyCFunction) InputDevice_push_events, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"set_button_points", (PyCFunction) InputDevice_set_button_points, METH_VARARGS | METH_KEYWORDS, NULL},
+#if LV_USE_GROUP
+    {"set_group", (PyCFunction) InputDevice_set_group, METH_VARARGS | METH_KEYWORDS, NULL},
+#endif
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef InputDevice_getset[] = {
+    {"type", (getter) InputDevice_get_type, NULL, "input device type (INDEV_TYPE)", NULL},
+    {"id", (getter) InputDevice_get_id, NULL, "device id in input recordings", NULL},
+    {"pending", (getter) InputDevice_get_pending, NULL, "number of queued events not yet read by lvgl", NULL},
+    {"dropped", (getter) InputDevice_get_dropped, NULL, "number of events dropped because the queue was full", NULL},
+    {"handle", (getter) InputDevice_get_handle, NULL, "device handle for the C API", NULL},
+#if LV_USE_GROUP
+    {"group", (getter) InputDevice_get_group, NULL, "Group controlled by a keypad or encoder, see set_group", NULL},
+#endif
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject InputDevice_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.InputDevice",
+    .tp_basicsize = sizeof(InputDeviceObject),
+    .tp_dealloc = (destructor) InputDevice_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "lvgl input device with an event queue",
+    .tp_methods = InputDevice_methods,
+    .tp_getset = InputDevice_getset,
+    .tp_init = (initproc) InputDevice_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+/****************************************************************
+ *  Input recording and replay                                  *
+ ****************************************************************/
+
+/* All events read by lvgl from InputDevice queues can be recorded to a
+ * binary log, which can be replayed by an lv_task, i.e. without Python
+ * involvement, at the original or an accelerated speed.
+ *
+ * The log is an input_log_header_t followed by input_record_t records, in
+ * native byte order. The recording is shared by all interpreters and
+ * protected by the lvgl lock.
+ */
+
+#define INPUT_LOG_MAGIC "LVIR"
+#define INPUT_LOG_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+} input_log_header_t;
+
+typedef struct {
+    uint32_t tick; // lv_tick_get() when lvgl read the event
+    uint16_t device; // InputDevice id
+    uint8_t type; // lv_indev_type_t
+    uint8_t state; // lv_indev_state_t
+    int32_t a, b; // see input_event_init
+} input_record_t;
+
+static struct {
+    input_record_t *records;
+    size_t n, size;
+} input_log;
+
+static void input_record(input_dev_t *dev, const lv_indev_data_t *data) {
+    input_record_t *record;
+    
+    if (input_log.n == input_log.size) {
+        // Called from indev_read, possibly without the GIL
+        size_t size = input_log.size ? input_log.size * 2 : 1024;
+        input_record_t *records = PyMem_RawRealloc(input_log.records, size * sizeof(input_record_t));
+        if (!records) return; // the event is not recorded
+        input_log.records = records;
+        input_log.size = size;
+    }
+    
+    record = &input_log.records[input_log.n++];
+    memset(record, 0, sizeof(*record));
+    record->tick = lv_tick_get();
+    record->device = dev->id;
+    record->type = dev->driver.type;
+    record->state = data->state;
+    switch (dev->driver.type) {
+        case LV_INDEV_TYPE_POINTER:
+            record->a = data->point.x;
+            record->b = data->point.y;
+            break;
+        case LV_INDEV_TYPE_KEYPAD:
+            record->a = data->key;
+            break;
+        case LV_INDEV_TYPE_BUTTON:
+            record->a = data->btn_id;
+            break;
+        case LV_INDEV_TYPE_ENCODER:
+            record->a = data->enc_diff;
+            break;
+        default:
+            break;
+    }
+}
+
+static PyObject *
+record_input(PyObject *self, PyObject *args) {
+    LVGL_LOCK
+    input_log.n = 0;
+    input_recording = true;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+// Stop recording, and return the log as bytes
+static PyObject *
+stop_input_recording(PyObject *self, PyObject *args) {
+    input_log_header_t header = {INPUT_LOG_MAGIC, INPUT_LOG_VERSION, sizeof(input_record_t)};
+    PyObject *ret;
+    
+    LVGL_LOCK
+    input_recording = false;
+    ret = PyBytes_FromStringAndSize(NULL, sizeof(header) + input_log.n * sizeof(input_record_t));
+    if (ret) {
+        memcpy(PyBytes_AS_STRING(ret), &header, sizeof(header));
+        memcpy(PyBytes_AS_STRING(ret) + sizeof(header), input_log.records, input_log.n * sizeof(input_record_t));
+    }
+    PyMem_RawFree(input_log.records);
+    input_log.records = NULL;
+    input_log.n = input_log.size = 0;
+    LVGL_UNLOCK
+    
+    return ret;
+}
+
+
+/* lvgl.InputReplay, returned by lvgl.replay_input(log, speed=1.0, devices=None)
+ *
+ * The events are pushed onto the queues of the devices from an lv_task, at
+ * their recorded time (relative to the first event) divided by speed.
+ * Recorded device ids are mapped to InputDevices by devices (a dict); ids
+ * not in devices are replayed on the default device of the recorded type.
+ *
+ * Deallocating the InputReplay stops the replay.
+ */
+typedef struct {
+    PyObject_HEAD
+    input_record_t *records;
+    input_dev_t **targets; // per record
+    PyObject *devices; // list of the InputDevices of targets, kept alive
+    size_t n, pos;
+    double speed;
+    uint32_t start_tick;
+    lv_task_t *task;
+} InputReplayObject;
+
+static PyTypeObject InputReplay_Type;
+
+static void replay_task_cb(lv_task_t *task) {
+    InputReplayObject *self = task->user_data;
+    double elapsed = lv_tick_elaps(self->start_tick) * self->speed; // in recorded time
+    uint32_t first = self->records[0].tick;
+    input_record_t *record;
+    input_event_t event;
+    
+    for (; self->pos < self->n; self->pos++) {
+        record = &self->records[self->pos];
+        if ((uint32_t) (record->tick - first) > elapsed) break;
+        
+        input_event_init(&event, record->type, record->a, record->b, record->state, lv_tick_get());
+        input_queue_lock(&self->targets[self->pos]->queue);
+        input_queue_push(&self->targets[self->pos]->queue, &event);
+        input_queue_unlock(&self->targets[self->pos]->queue);
+    }
+    
+    if (self->pos == self->n) {
+        lv_task_del(task);
+        self->task = NULL;
+        return;
+    }
+    
+    // Run again when the next event is due
+    lv_task_set_period(task, (uint32_t) ((record->tick - first - elapsed) / self->speed) + 1);
+}
+
+static void
+InputReplay_stop_task(InputReplayObject *self) {
+    LVGL_LOCK
+    if (self->task) {
+        lv_task_del(self->task);
+        self->task = NULL;
+    }
+    LVGL_UNLOCK
+}
+
+static void
+InputReplay_dealloc(InputReplayObject *self) {
+    InputReplay_stop_task(self);
+    PyMem_Free(self->records);
+    PyMem_Free(self->targets);
+    Py_XDECREF(self->devices);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+InputReplay_stop(InputReplayObject *self, PyObject *args) {
+    InputReplay_stop_task(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+InputReplay_get_done(InputReplayObject *self, void *closure) {
+    PyObject *ret;
+    LVGL_LOCK
+    ret = PyBool_FromLong(!self->task);
+    LVGL_UNLOCK
+    return ret;
+}
+
+static PyObject *
+InputReplay_get_position(InputReplayObject *self, void *closure) {
+    PyObject *ret;
+    LVGL_LOCK
+    ret = PyLong_FromSize_t(self->pos);
+    LVGL_UNLOCK
+    return ret;
+}
+
+static PyObject *
+InputReplay_get_events(InputReplayObject *self, void *closure) {
+    return PyLong_FromSize_t(self->n);
+}
+
+static PyMethodDef InputReplay_methods[] = {
+    {"stop", (PyCFunction) InputReplay_stop, METH_NOARGS, NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef InputReplay_getset[] = {
+    {"done", (getter) InputReplay_get_done, NULL, "True when all events have been replayed, or the replay was stopped", NULL},
+    {"position", (getter) InputReplay_get_position, NULL, "number of events replayed", NULL},
+    {"events", (getter) InputReplay_get_events, NULL, "number of events in the log", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject InputReplay_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.InputReplay",
+    .tp_basicsize = sizeof(InputReplayObject),
+    .tp_dealloc = (destructor) InputReplay_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "replay of an input recording, see lvgl.replay_input",
+    .tp_methods = InputReplay_methods,
+    .tp_getset = InputReplay_getset,
+    .tp_new = NULL, // cannot be instantiated
+};
+
+static input_dev_t *get_input_dev(lvgl_state *state, long type);
+
+static PyObject *
+replay_input(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"log", "speed", "devices", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    Py_buffer log;
+    double speed = 1.0;
+    PyObject *devices = Py_None, *device;
+    input_log_header_t header;
+    InputReplayObject *replay = NULL;
+    size_t n;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "y*|dO", kwlist, &log, &speed, &devices)) {
+        return NULL;
+    }
+    
+    if (speed <= 0) {
+        PyErr_SetString(PyExc_ValueError, "speed must be positive");
+        goto error;
+    }
+    if ((devices != Py_None) && !PyDict_Check(devices)) {
+        PyErr_SetString(PyExc_TypeError, "devices must be a dict of recorded device id --> InputDevice");
+        goto error;
+    }
+    if (log.len >= sizeof(header)) memcpy(&header, log.buf, sizeof(header));
+    if ((log.len < sizeof(header)) || memcmp(header.magic, INPUT_LOG_MAGIC, 4) ||
+            (header.version != INPUT_LOG_VERSION) || (header.record_size != sizeof(input_record_t)) ||
+            ((log.len - sizeof(header)) % sizeof(input_record_t))) {
+        PyErr_SetString(PyExc_ValueError, "invalid input log");
+        goto error;
+    }
+    n = (log.len - sizeof(header)) / sizeof(input_record_t);
+    
+    replay = PyObject_New(InputReplayObject, &InputReplay_Type);
+    if (!replay) goto error;
+    replay->records = PyMem_Malloc(n * sizeof(input_record_t) + 1);
+    replay->targets = PyMem_Malloc(n * sizeof(input_dev_t *) + 1);
+    replay->devices = PyList_New(0);
+    replay->n = n;
+    replay->pos = 0;
+    replay->speed = speed;
+    replay->task = NULL;
+    if (!replay->records || !replay->targets) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (!replay->devices) goto error;
+    memcpy(replay->records, (char *) log.buf + sizeof(header), n * sizeof(input_record_t));
+    
+    // Resolve the target device of every record
+    for (size_t i = 0; i < n; i++) {
+        input_record_t *record = &replay->records[i];
+        PyObject *id = PyLong_FromLong(record->device);
+        if (!id) goto error;
+        device = (devices != Py_None) ? PyDict_GetItemWithError(devices, id) : NULL; // borrowed reference
+        Py_DECREF(id);
+        if (PyErr_Occurred()) goto error;
+        
+        if (device) {
+            if (!PyObject_TypeCheck(device, &InputDevice_Type)) {
+                PyErr_SetString(PyExc_TypeError, "devices must be a dict of recorded device id --> InputDevice");
+                goto error;
+            }
+            replay->targets[i] = InputDevice_get((InputDeviceObject *) device);
+            if (!replay->targets[i]) goto error;
+        } else {
+            replay->targets[i] = get_input_dev(state, record->type);
+            if (!replay->targets[i]) goto error;
+            device = state->input[record->type];
+        }
+        if (replay->targets[i]->driver.type != record->type) {
+            PyErr_Format(PyExc_ValueError, "recorded device %d has a different type", record->device);
+            goto error;
+        }
+        if (!PySequence_Contains(replay->devices, device) && PyList_Append(replay->devices, device)) goto error;
+    }
+    PyBuffer_Release(&log);
+    
+    if (n) {
+        LVGL_LOCK
+        replay->start_tick = lv_tick_get();
+        replay->task = lv_task_create(replay_task_cb, 0, LV_TASK_PRIO_HIGHEST, replay);
+        LVGL_UNLOCK
+        if (!replay->task) {
+            Py_DECREF(replay);
+            return PyErr_NoMemory();
+        }
+    }
+    return (PyObject *) replay;
+    
+error:
+    PyBuffer_Release(&log);
+    Py_XDECREF(replay);
+    return NULL;
+}
+
+
+/* lvgl.Task(callback, period=500, prio=TASK_PRIO.MID, coalesce=True)
+ *
+ * Calls callback(task) from lv_task_handler (i.e. in lvgl.poll) every period
+ * ms. The task is scheduled by lvgl, so Python is only entered when it is
+ * due, and it is taken into account by lvgl.wait() and the poll deadline.
+ *
+ * The schedule keeps its phase: a late run does not delay the next one. When
+ * whole periods were missed (e.g. lvgl was not polled for a while), they are
+ * coalesced into a single call, with task.missed set to the number of missed
+ * periods, or with coalesce=False, the callback is called for every period.
+ *
+ * A scheduled task keeps itself alive, until del_() is called or, after
+ * once(), until it has run. set_period, set_prio, ready and once are
+ * generated from the lv_task functions (see PYLV_TASK_METHODS).
+ */
+typedef struct {
+    PyObject_HEAD
+    lv_task_t *ref;
+    PyObject *callback;
+    PyInterpreterState *interp;
+    uint32_t last_run; // start of the current period
+    uint32_t missed; // periods coalesced into the last run
+    bool coalesce;
+} pylv_Task;
+
+static PyTypeObject pylv_Task_Type;
+
+static int check_task(pylv_Task *self) {
+    if (!self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "the task has been deleted");
+        return -1;
+    }
+    return 0;
+}
+
+static void task_cb(lv_task_t *task) {
+    pylv_Task *self = task->user_data;
+    uint32_t runs = 1;
+    PyObject *result;
+    
+    // lvgl has set last_run to now; restore the phase of the schedule. A run
+    // before the period has elapsed (lv_task_ready) does not shift it.
+    if (task->period) {
+        runs = lv_tick_elaps(self->last_run) / task->period;
+        self->last_run += runs * task->period;
+        task->last_run = self->last_run;
+    } else {
+        self->last_run = task->last_run;
+    }
+    self->missed = runs ? runs - 1 : 0;
+    if (self->coalesce || !runs) runs = 1;
+    
+    PyThreadState *prev = interp_enter(self->interp);
+    uint64_t t0 = monotonic_ns();
+    Py_INCREF(self); // the callback may delete the task
+    for (uint32_t i = 0; (i < runs) && self->ref; i++) {
+        result = PyObject_CallFunctionObjArgs(self->callback, (PyObject *) self, NULL);
+        if (result && PyCoro_CheckExact(result)) result = run_coroutine(result);
+        if (result) {
+            Py_DECREF(result);
+        } else {
+            PyErr_Print();
+            PyErr_Clear();
+        }
+    }
+    
+    // After lv_task_once, lvgl deletes the task when this returns
+    if (self->ref && task->once) {
+        self->ref = NULL;
+        Py_DECREF(self);
+    }
+    Py_DECREF(self);
+    frame_current.callbacks++;
+    frame_current.callback_ns += monotonic_ns() - t0;
+    interp_leave(prev);
+}
+
+/* Delete the tasks created in interp, which exits (see lvgl_atexit). Must be
+ * called with the lvgl lock held
+ */
+static void task_delete_all(PyInterpreterState *interp) {
+    lv_task_t *task, *next;
+    pylv_Task *pytask;
+    
+    for (task = lv_ll_get_head(&LV_GC_ROOT(_lv_task_ll)); task; task = next) {
+        next = lv_ll_get_next(&LV_GC_ROOT(_lv_task_ll), task);
+        if (task->task_cb != task_cb) continue;
+        pytask = task->user_data;
+        if (pytask->interp != interp) continue;
+        lv_task_del(task);
+        pytask->ref = NULL;
+        Py_DECREF(pytask);
+    }
+}
+
+static int
+Task_init(pylv_Task *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"callback", "period", "prio", "coalesce", NULL};
+    PyObject *callback;
+    unsigned int period = 500;
+    int prio = LV_TASK_PRIO_MID;
+    int coalesce = 1;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|Iip", kwlist, &callback, &period, &prio, &coalesce)) {
+        return -1;
+    }
+    if (!PyCallable_Check(callback)) {
+        PyErr_SetString(PyExc_TypeError, "callback must be callable");
+        return -1;
+    }
+    if ((prio < LV_TASK_PRIO_OFF) || (prio > LV_TASK_PRIO_HIGHEST)) {
+        PyErr_Format(PyExc_ValueError, "invalid task priority %d", prio);
+        return -1;
+    }
+    if (self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "Task is already initialized");
+        return -1;
+    }
+    if (check_mem()) return -1;
+    
+    Py_INCREF(callback);
+    Py_XSETREF(self->callback, callback);
+    self->coalesce = coalesce;
+    self->interp = PyInterpreterState_Get();
+    
+    LVGL_LOCK
+    self->ref = lv_task_create(task_cb, period, prio, self);
+    if (self->ref) {
+        self->last_run = self->ref->last_run;
+        Py_INCREF(self); // released when the task is deleted
+    }
+    LVGL_UNLOCK
+    
+    if (!self->ref) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static int
+Task_traverse(pylv_Task *self, visitproc visit, void *arg) {
+    Py_VISIT(self->callback);
+    return 0;
+}
+
+static int
+Task_clear(pylv_Task *self) {
+    Py_CLEAR(self->callback);
+    return 0;
+}
+
+static void
+Task_dealloc(pylv_Task *self) {
+    // A scheduled task holds a reference to itself, so ref is NULL here
+    PyObject_GC_UnTrack(self);
+    Task_clear(self);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+Task_del(pylv_Task *self, PyObject *args) {
+    if (check_task(self)) return NULL;
+    
+    LVGL_LOCK
+    if (self->ref) {
+        lv_task_del(self->ref);
+        self->ref = NULL;
+        Py_DECREF(self);
+    }
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+// Restart the current period from now
+static PyObject *
+Task_reset(pylv_Task *self, PyObject *args) {
+    if (check_task(self)) return NULL;
+    
+    LVGL_LOCK
+    lv_task_reset(self->ref);
+    self->last_run = self->ref->last_run;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Task_get_period(pylv_Task *self, void *closure) {
+    if (check_task(self)) return NULL;
+    return PyLong_FromUnsignedLong(self->ref->period);
+}
+
+static PyObject *
+Task_get_callback(pylv_Task *self, void *closure) {
+    Py_INCREF(self->callback);
+    return self->callback;
+}
+
+static int
+Task_set_callback(pylv_Task *self, PyObject *value, void *closure) {
+    PyObject *old_callback;
+    
+    if (!value || !PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "callback must be callable");
+        return -1;
+    }
+    Py_INCREF(value);
+    
+    // task_cb may be reading it from another thread
+    LVGL_LOCK
+    old_callback = self->callback;
+    self->callback = value;
+    LVGL_UNLOCK
+    
+    Py_XDECREF(old_callback);
+    return 0;
+}
+
+static PyObject *
+Task_get_missed(pylv_Task *self, void *closure) {
+    return PyLong_FromUnsignedLong(self->missed);
+}
+
+static PyObject *
+Task_get_active(pylv_Task *self, void *closure) {
+    return PyBool_FromLong(self->ref != NULL);
+}
+
+#if LV_USE_ANIMATION
+/* lvgl.Anim(target, prop, start, end, time=500, delay=0, path=ANIM_PATH.LINEAR, ready_cb=None)
+ *
+ * Animates a property of an object ('x', 'y', 'width', 'height' or 'opa') or
+ * an integer field of a style_t (e.g. 'body.radius', 'text.opa'), from start
+ * to end. The animation is run by lvgl's animation task, and the property is
+ * set by the exec callbacks below, so no Python code runs while it is
+ * animating. Python is only entered when the animation completes, to call
+ * ready_cb(anim).
+ *
+ * The Anim is a template: start() starts a copy of it in lvgl, which replaces
+ * a running animation of the same property. set_time, set_values,
+ * set_playback, set_repeat etc. are generated from the lv_anim functions (see
+ * PYLV_ANIM_METHODS) and apply to the next start(). A running animation keeps
+ * the Anim alive, until it completes, is stopped or its object is deleted.
+ */
+typedef struct pylv_Anim {
+    PyObject_HEAD
+    lv_anim_t *ref; // &anim, for the generated methods
+    lv_anim_t anim;
+    PyObject *target; // Obj or style_t
+    PyObject *ready_cb;
+    PyInterpreterState *interp;
+    lv_anim_exec_cb_t exec_cb;
+    size_t field_offset; // style_t field
+    uint8_t field_size;
+    bool running;
+    void *var; // var of the running animation
+    struct pylv_Anim *prev, *next; // in anim_running
+} pylv_Anim;
+
+static PyTypeObject pylv_Anim_Type;
+
+/* The running animations, to find them when their object is deleted or they
+ * are replaced. Protected by the lvgl lock
+ */
+static pylv_Anim *anim_running;
+
+static int check_anim(pylv_Anim *self) {
+    if (!self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "Anim is not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+static void anim_exec_x(void *var, lv_anim_value_t value) {
+    lv_obj_set_x(var, value);
+}
+
+static void anim_exec_y(void *var, lv_anim_value_t value) {
+    lv_obj_set_y(var, value);
+}
+
+static void anim_exec_width(void *var, lv_anim_value_t value) {
+    lv_obj_set_width(var, value);
+}
+
+static void anim_exec_height(void *var, lv_anim_value_t value) {
+    lv_obj_set_height(var, value);
+}
+
+static void anim_exec_opa(void *var, lv_anim_value_t value) {
+    lv_obj_set_opa_scale_enable(var, true);
+    lv_obj_set_opa_scale(var, value < LV_OPA_TRANSP ? LV_OPA_TRANSP : value > LV_OPA_COVER ? LV_OPA_COVER : value);
+}
+
+/* The animatable style fields. Each has its own exec callback, and var is the
+ * address of the field, such that lvgl (and Anim_start) see animations of the
+ * same field of the same style as the same animation
+ */
+#define ANIM_STYLE_FIELDS(X) \
+    X(body_radius, body.radius) \
+    X(body_opa, body.opa) \
+    X(body_border_width, body.border.width) \
+    X(body_border_opa, body.border.opa) \
+    X(body_shadow_width, body.shadow.width) \
+    X(body_padding_top, body.padding.top) \
+    X(body_padding_bottom, body.padding.bottom) \
+    X(body_padding_left, body.padding.left) \
+    X(body_padding_right, body.padding.right) \
+    X(body_padding_inner, body.padding.inner) \
+    X(text_letter_space, text.letter_space) \
+    X(text_line_space, text.line_space) \
+    X(text_opa, text.opa) \
+    X(image_intense, image.intense) \
+    X(image_opa, image.opa) \
+    X(line_width, line.width) \
+    X(line_opa, line.opa)
+
+#define ANIM_EXEC_STYLE(name, field) \
+    static void anim_exec_style_##name(void *var, lv_anim_value_t value) { \
+        lv_style_t *style = (lv_style_t *) ((char *) var - offsetof(lv_style_t, field)); \
+        style->field = value; \
+        lv_obj_report_style_mod(style); \
+    }
+ANIM_STYLE_FIELDS(ANIM_EXEC_STYLE)
+
+static const struct {
+    const char *name;
+    lv_anim_exec_cb_t exec_cb;
+} anim_obj_props[] = {
+    {"x", (lv_anim_exec_cb_t) anim_exec_x},
+    {"y", (lv_anim_exec_cb_t) anim_exec_y},
+    {"width", (lv_anim_exec_cb_t) anim_exec_width},
+    {"height", (lv_anim_exec_cb_t) anim_exec_height},
+    {"opa", (lv_anim_exec_cb_t) anim_exec_opa},
+    {NULL}
+};
+
+#define ANIM_STYLE_FIELD(name, field) {#field, offsetof(lv_style_t, field), sizeof(((lv_style_t *)0)->field), anim_exec_style_##name},
+static const struct {
+    const char *name;
+    size_t offset;
+    uint8_t size;
+    lv_anim_exec_cb_t exec_cb;
+} anim_style_fields[] = {
+    ANIM_STYLE_FIELDS(ANIM_STYLE_FIELD)
+    {NULL}
+};
+
+// Indexed by the values of lvgl.ANIM_PATH
+static const lv_anim_path_cb_t anim_paths[] = {
+    lv_anim_path_linear,
+    lv_anim_path_ease_in,
+    lv_anim_path_ease_out,
+    lv_anim_path_ease_in_out,
+    lv_anim_path_overshoot,
+    lv_anim_path_bounce,
+    lv_anim_path_step,
+};
+
+static const enum_item_t enum_ANIM_PATH_items[] = {{"LINEAR", 0}, {"EASE_IN", 1}, {"EASE_OUT", 2}, {"EASE_IN_OUT", 3}, {"OVERSHOOT", 4}, {"BOUNCE", 5}, {"STEP", 6}, {NULL}};
+
+static int anim_set_path(pylv_Anim *self, int path) {
+    if ((path < 0) || (path >= (int) (sizeof(anim_paths) / sizeof(anim_paths[0])))) {
+        PyErr_Format(PyExc_ValueError, "invalid animation path %d", path);
+        return -1;
+    }
+    self->anim.path_cb = anim_paths[path];
+    return 0;
+}
+
+/* Remove self from the running animations, after lvgl has deleted it. Must
+ * be called with the lvgl lock held. May deallocate self
+ */
+static void anim_finished(pylv_Anim *self) {
+    if (!self->running) return;
+    if (self->prev) self->prev->next = self->next;
+    else anim_running = self->next;
+    if (self->next) self->next->prev = self->prev;
+    self->prev = self->next = NULL;
+    self->running = false;
+    Py_DECREF(self);
+}
+
+static void anim_ready_cb(lv_anim_t *a) {
+    pylv_Anim *self = a->user_data;
+    PyObject *result;
+    
+    PyThreadState *prev = interp_enter(self->interp);
+    uint64_t t0 = monotonic_ns();
+    Py_INCREF(self); // ready_cb may start the animation again
+    anim_finished(self);
+    if (self->ready_cb) {
+        result = PyObject_CallFunctionObjArgs(self->ready_cb, (PyObject *) self, NULL);
+        if (result && PyCoro_CheckExact(result)) result = run_coroutine(result);
+        if (result) {
+            Py_DECREF(result);
+        } else {
+            PyErr_Print();
+            PyErr_Clear();
+        }
+        frame_current.callbacks++;
+        frame_current.callback_ns += monotonic_ns() - t0;
+    }
+    Py_DECREF(self);
+    interp_leave(prev);
+}
+
+/* lv_obj_del deletes the animations of the object without calling their
+ * ready_cb. Called from pylv_signal_cb, with the lvgl lock held
+ */
+static void anim_obj_deleted(lv_obj_t *obj) {
+    pylv_Anim *anim, *next;
+    
+    for (anim = anim_running; anim; anim = next) {
+        next = anim->next;
+        if (!anim->field_size && (anim->var == obj)) anim_finished(anim);
+    }
+}
+
+/* Stop the animations started in interp, which exits (see lvgl_atexit). Must
+ * be called with the lvgl lock held
+ */
+static void anim_stop_all(PyInterpreterState *interp) {
+    pylv_Anim *anim, *next;
+    
+    for (anim = anim_running; anim; anim = next) {
+        next = anim->next;
+        if (anim->interp != interp) continue;
+        lv_anim_del(anim->var, anim->exec_cb);
+        anim_finished(anim);
+    }
+}
+
+static int
+Anim_init(pylv_Anim *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"target", "prop", "start", "end", "time", "delay", "path", "ready_cb", NULL};
+    PyObject *target, *ready_cb = Py_None;
+    const char *prop;
+    short int start, end, delay = 0; // as in set_values and set_time
+    unsigned short int time = 500;
+    int path = 0;
+    StructObject *style;
+    int i;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oshh|HhiO", kwlist, &target, &prop, &start, &end, &time, &delay, &path, &ready_cb)) {
+        return -1;
+    }
+    if (self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "Anim is already initialized");
+        return -1;
+    }
+    if ((ready_cb != Py_None) && !PyCallable_Check(ready_cb)) {
+        PyErr_SetString(PyExc_TypeError, "ready_cb must be callable or None");
+        return -1;
+    }
+    
+    if (PyObject_TypeCheck(target, &pylv_obj_Type)) {
+        for (i = 0; anim_obj_props[i].name && strcmp(anim_obj_props[i].name, prop); i++);
+        if (!anim_obj_props[i].name) {
+            PyErr_Format(PyExc_ValueError, "cannot animate object property '%s'", prop);
+            return -1;
+        }
+        self->exec_cb = anim_obj_props[i].exec_cb;
+    } else if (PyObject_TypeCheck(target, &pylv_style_t_Type)) {
+        style = (StructObject *) target;
+        if (style->readonly) {
+            PyErr_SetString(PyExc_TypeError, "cannot animate a read-only style");
+            return -1;
+        }
+        for (i = 0; anim_style_fields[i].name && strcmp(anim_style_fields[i].name, prop); i++);
+        if (!anim_style_fields[i].name) {
+            PyErr_Format(PyExc_ValueError, "cannot animate style field '%s'", prop);
+            return -1;
+        }
+        self->exec_cb = anim_style_fields[i].exec_cb;
+        self->field_offset = anim_style_fields[i].offset;
+        self->field_size = anim_style_fields[i].size;
+    } else {
+        PyErr_Format(PyExc_TypeError, "target must be an Obj or a style_t, not %.200s", Py_TYPE(target)->tp_name);
+        return -1;
+    }
+    
+    lv_anim_init(&self->anim);
+    lv_anim_set_values(&self->anim, start, end);
+    lv_anim_set_time(&self->anim, time, delay);
+    if (anim_set_path(self, path)) return -1;
+    
+    Py_INCREF(target);
+    self->target = target;
+    if (ready_cb != Py_None) {
+        Py_INCREF(ready_cb);
+        self->ready_cb = ready_cb;
+    }
+    self->interp = PyInterpreterState_Get();
+    self->ref = &self->anim;
+    return 0;
+}
+
+static int
+Anim_traverse(pylv_Anim *self, visitproc visit, void *arg) {
+    Py_VISIT(self->target);
+    Py_VISIT(self->ready_cb);
+    return 0;
+}
+
+static int
+Anim_clear(pylv_Anim *self) {
+    Py_CLEAR(self->ready_cb);
+    return 0;
+}
+
+static void
+Anim_dealloc(pylv_Anim *self) {
+    // A running animation holds a reference to its Anim, so it is stopped here
+    PyObject_GC_UnTrack(self);
+    Anim_clear(self);
+    Py_CLEAR(self->target);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+Anim_start(pylv_Anim *self, PyObject *args) {
+    lv_anim_t a;
+    void *var;
+    pylv_Anim *anim;
+    
+    if (check_anim(self)) return NULL;
+    if (self->field_size) {
+        var = ((StructObject *) self->target)->data + self->field_offset;
+    } else {
+        if (check_alive((pylv_Obj *) self->target)) return NULL;
+        var = ((pylv_Obj *) self->target)->ref;
+    }
+    if (check_mem()) return NULL;
+    
+    a = self->anim;
+    a.var = var;
+    a.exec_cb = self->exec_cb;
+    a.ready_cb = anim_ready_cb;
+    a.user_data = self;
+    
+    LVGL_LOCK
+    // lv_anim_create replaces the running animation with the same var and
+    // exec_cb, which may be another Anim or an earlier start of this one
+    for (anim = anim_running; anim; anim = anim->next) {
+        if ((anim->var == var) && (anim->exec_cb == self->exec_cb)) {
+            anim_finished(anim);
+            break;
+        }
+    }
+    lv_anim_create(&a);
+    
+    Py_INCREF(self); // released when the animation has finished
+    self->var = var;
+    self->running = true;
+    self->prev = NULL;
+    self->next = anim_running;
+    if (anim_running) anim_running->prev = self;
+    anim_running = self;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+// Stop the animation, without calling ready_cb
+static PyObject *
+Anim_stop(pylv_Anim *self, PyObject *args) {
+    if (check_anim(self)) return NULL;
+    
+    LVGL_LOCK
+    if (self->running) {
+        lv_anim_del(self->var, self->exec_cb);
+        anim_finished(self);
+    }
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Anim_set_path(pylv_Anim *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"path", NULL};
+    int path;
+    
+    if (check_anim(self)) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i", kwlist, &path)) return NULL;
+    if (anim_set_path(self, path)) return NULL;
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Anim_get_running(pylv_Anim *self, void *closure) {
+    return PyBool_FromLong(self->running);
+}
+
+static PyObject *
+Anim_get_target(pylv_Anim *self, void *closure) {
+    if (!self->target) Py_RETURN_NONE;
+    Py_INCREF(self->target);
+    return self->target;
+}
+
+static PyObject *
+Anim_get_ready_cb(pylv_Anim *self, void *closure) {
+    if (!self->ready_cb) Py_RETURN_NONE;
+    Py_INCREF(self->ready_cb);
+    return self->ready_cb;
+}
+
+static int
+Anim_set_ready_cb(pylv_Anim *self, PyObject *value, void *closure) {
+    PyObject *old_ready_cb;
+    
+    if (!value || ((value != Py_None) && !PyCallable_Check(value))) {
+        PyErr_SetString(PyExc_TypeError, "ready_cb must be callable or None");
+        return -1;
+    }
+    if (value == Py_None) value = NULL;
+    Py_XINCREF(value);
+    
+    // anim_ready_cb may be reading it from another thread
+    LVGL_LOCK
+    old_ready_cb = self->ready_cb;
+    self->ready_cb = value;
+    LVGL_UNLOCK
+    
+    Py_XDECREF(old_ready_cb);
+    return 0;
+}
+#endif
+
+#if LV_USE_GROUP
+/* lvgl.Group()
+ *
+ * A focus group. Objects are added with add_obj, and a keypad or encoder
+ * InputDevice which has the group (InputDevice.set_group, lvgl.set_group)
+ * moves the focus and sends keys to the focused object inside lvgl, without
+ * calling into Python. The methods are generated from the lv_group functions
+ * (see PYLV_GROUP_METHODS); get_focused returns the Python object of the
+ * focused object (see pyobj_from_lv).
+ *
+ * lvgl removes a deleted object from its group, so the group does not keep
+ * the Python objects of its members alive. An InputDevice keeps its group
+ * alive.
+ */
+typedef struct {
+    PyObject_HEAD
+    lv_group_t *ref;
+} pylv_Group;
+
+static PyTypeObject pylv_Group_Type;
+
+static int check_group(pylv_Group *self) {
+    if (!self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "the group has been deleted");
+        return -1;
+    }
+    return 0;
+}
+
+/* lv_group_del does not remove the group from the input devices, so that is
+ * done here, releasing the reference of their InputDevice. Must be called
+ * with the lvgl lock held
+ */
+static void group_detach(lv_group_t *group) {
+    lv_indev_t *indev;
+    InputDeviceObject *device;
+    
+    for (indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+        if (indev->group != group) continue;
+        lv_indev_set_group(indev, NULL);
+        if ((indev->driver.read_cb == indev_read) && indev->driver.user_data) {
+            device = (InputDeviceObject *) ((char *) indev->driver.user_data - offsetof(InputDeviceObject, dev));
+            Py_CLEAR(device->group);
+        }
+    }
+}
+
+static int
+Group_init(pylv_Group *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) {
+        return -1;
+    }
+    if (self->ref) {
+        PyErr_SetString(PyExc_RuntimeError, "Group is already initialized");
+        return -1;
+    }
+    if (check_mem()) return -1;
+    
+    LVGL_LOCK
+    self->ref = lv_group_create();
+    LVGL_UNLOCK
+    
+    if (!self->ref) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void
+Group_dealloc(pylv_Group *self) {
+    if (self->ref) {
+        LVGL_LOCK
+        group_detach(self->ref);
+        lv_group_del(self->ref);
+        LVGL_UNLOCK
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+Group_del(pylv_Group *self, PyObject *args) {
+    if (check_group(self)) return NULL;
+    
+    LVGL_LOCK
+    group_detach(self->ref);
+    lv_group_del(self->ref);
+    self->ref = NULL;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+/* InputDevice.set_group(group): let a keypad or encoder control the focus of
+ * group (None to remove the group)
+ */
+static int input_dev_set_group(InputDeviceObject *device, PyObject *group) {
+    PyObject *old_group;
+    
+    if ((group != Py_None) && !PyObject_TypeCheck(group, &pylv_Group_Type)) {
+        PyErr_Format(PyExc_TypeError, "group must be a Group or None, not %.200s", Py_TYPE(group)->tp_name);
+        return -1;
+    }
+    if ((group != Py_None) && check_group((pylv_Group *) group)) return -1;
+    if ((device->dev.driver.type != LV_INDEV_TYPE_KEYPAD) && (device->dev.driver.type != LV_INDEV_TYPE_ENCODER)) {
+        PyErr_SetString(PyExc_ValueError, "only keypad and encoder input devices can have a group");
+        return -1;
+    }
+    if (group == Py_None) group = NULL;
+    Py_XINCREF(group);
+    
+    LVGL_LOCK
+    old_group = device->group;
+    device->group = group;
+    lv_indev_set_group(device->dev.indev, group ? ((pylv_Group *) group)->ref : NULL);
+    LVGL_UNLOCK
+    
+    Py_XDECREF(old_group);
+    return 0;
+}
+
+static PyObject *
+InputDevice_set_group(InputDeviceObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"group", NULL};
+    PyObject *group;
+    
+    if (!InputDevice_get(self)) return NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &group)) {
+        return NULL;
+    }
+    if (input_dev_set_group(self, group)) return NULL;
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+InputDevice_get_group(InputDeviceObject *self, void *closure) {
+    if (!self->group) Py_RETURN_NONE;
+    Py_INCREF(self->group);
+    return self->group;
+}
+#endif
+
+#if LV_USE_FILESYSTEM
+/* lvgl.FileSystem(letter, backend, buffer_size=4096)
+ *
+ * A read-only lvgl filesystem for the drive letter 'A'..'Z', so that e.g.
+ * Img.set_src('S:icons/ok.bin') loads from it. backend is either a directory
+ * (str, bytes or os.PathLike), which is read natively with stdio, or a Python
+ * object whose open(path, mode) returns a binary file object with
+ * readinto(buffer) and seek(offset, whence=0), such as an io.BufferedReader
+ * or a reader for an asset pack.
+ *
+ * Paths are relative to the backend. For a directory, paths which could
+ * leave it (an absolute path, a drive or a '..' component) are denied before
+ * the file is opened; symbolic links within the directory are followed.
+ * Python backends check the paths themselves.
+ *
+ * lvgl reads files in small pieces (headers, image lines), so these are
+ * served from a read-ahead buffer of buffer_size bytes per open file, and
+ * seeking within the buffer does not reach the backend. A read of at least
+ * buffer_size bytes bypasses the buffer: the backend reads directly into the
+ * lvgl memory, for Python backends through a memoryview which is released
+ * when readinto returns, so large assets are not copied through bytes
+ * objects.
+ *
+ * lvgl can not remove a filesystem driver, and the driver callbacks are not
+ * passed the driver, so a driver is added for a letter when it is first
+ * registered and its open callback looks up the FileSystem in fs_letters. A
+ * registered FileSystem stays alive until unregister() is called or its
+ * interpreter exits. An open file keeps its FileSystem alive.
+ */
+#define FS_LETTERS 26
+
+typedef struct {
+    uint64_t opens;
+    uint64_t reads;
+    uint64_t bytes; // returned to lvgl
+    uint64_t buffered_bytes; // of which copied from the read-ahead buffer
+    uint64_t direct_bytes; // of which read directly into the lvgl memory
+    uint64_t backend_reads; // fread or readinto calls
+    uint64_t backend_seeks;
+} fs_stats_t;
+
+typedef struct {
+    PyObject_HEAD
+    char letter;
+    char *root; // native backend: the directory, ending with a separator
+    PyObject *backend; // Python backend
+    PyInterpreterState *interp;
+    uint32_t buffer_size;
+    bool registered;
+    fs_stats_t stats;
+} pylv_FileSystem;
+
+static PyTypeObject pylv_FileSystem_Type;
+
+/* An open file; lvgl allocates one of these (lv_fs_drv_t.file_size) per
+ * lv_fs_open
+ */
+typedef struct {
+    pylv_FileSystem *fs;
+    FILE *fp; // native backend
+    PyObject *file; // Python backend
+    uint32_t pos; // position seen by lvgl
+    uint32_t backend_pos; // position of fp or file, FS_POS_UNKNOWN after an error
+    uint8_t *buf; // read-ahead buffer, allocated on the first buffered read
+    uint32_t buf_pos; // file position of buf[0]
+    uint32_t buf_len;
+} fs_open_file_t;
+
+#define FS_POS_UNKNOWN UINT32_MAX
+
+static pylv_FileSystem *fs_letters[FS_LETTERS];
+static bool fs_drv_added[FS_LETTERS];
+
+/* Convert the exception raised by a Python backend to an lv_fs_res_t, and
+ * clear it. Other than OSError and MemoryError, it is printed as for event
+ * callbacks
+ */
+static lv_fs_res_t fs_error_res(void) {
+    lv_fs_res_t res = LV_FS_RES_UNKNOWN;
+    
+    if (PyErr_ExceptionMatches(PyExc_FileNotFoundError)) res = LV_FS_RES_NOT_EX;
+    else if (PyErr_ExceptionMatches(PyExc_PermissionError)) res = LV_FS_RES_DENIED;
+    else if (PyErr_ExceptionMatches(PyExc_OSError)) res = LV_FS_RES_FS_ERR;
+    else if (PyErr_ExceptionMatches(PyExc_MemoryError)) res = LV_FS_RES_OUT_OF_MEM;
+    else PyErr_Print();
+    PyErr_Clear();
+    return res;
+}
+
+static lv_fs_res_t fs_errno_res(void) {
+    switch (errno) {
+        case ENOENT:
+        case ENOTDIR:
+            return LV_FS_RES_NOT_EX;
+        case EACCES:
+        case EPERM:
+            return LV_FS_RES_DENIED;
+        case ENOMEM:
+            return LV_FS_RES_OUT_OF_MEM;
+        default:
+            return LV_FS_RES_FS_ERR;
+    }
+}
+
+/* Whether a path stays within the directory of a native backend: it does not
+ * start with a separator, has no drive (or other ':'), and no '..' component.
+ * Both '/' and '\\' are separators, as on Windows.
+ */
+static bool fs_path_is_contained(const char *path) {
+    const char *component = path;
+    
+    if ((*path == '/') || (*path == '\\')) return false;
+    if (strchr(path, ':')) return false;
+    
+    for (;;) {
+        size_t len = strcspn(component, "/\\");
+        if ((len == 2) && (component[0] == '.') && (component[1] == '.')) return false;
+        if (!component[len]) return true;
+        component += len + 1;
+    }
+}
+
+static lv_fs_res_t fs_open(int index, void *file_p, const char *path, lv_fs_mode_t mode) {
+    pylv_FileSystem *fs = fs_letters[index];
+    fs_open_file_t *f = file_p;
+    lv_fs_res_t res = LV_FS_RES_OK;
+    PyObject *name;
+    char *fn;
+    
+    memset(f, 0, sizeof(*f));
+    if (!fs) return LV_FS_RES_NOT_EX;
+    if (mode & LV_FS_MODE_WR) return LV_FS_RES_DENIED;
+    
+    if (fs->root) {
+        if (!fs_path_is_contained(path)) return LV_FS_RES_DENIED;
+        fn = PyMem_Malloc(strlen(fs->root) + strlen(path) + 1);
+        if (!fn) return LV_FS_RES_OUT_OF_MEM;
+        strcpy(fn, fs->root);
+        strcat(fn, path);
+        f->fp = fopen(fn, "rb");
+        PyMem_Free(fn);
+        if (!f->fp) return fs_errno_res();
+        // reads are buffered here
+        setvbuf(f->fp, NULL, _IONBF, 0);
+    } else {
+        PyThreadState *prev = interp_enter(fs->interp);
+        name = PyUnicode_DecodeFSDefault(path);
+        if (name) {
+            f->file = PyObject_CallMethod(fs->backend, "open", "Os", name, "rb");
+            Py_DECREF(name);
+        }
+        if (!f->file) res = fs_error_res();
+        interp_leave(prev);
+        if (res != LV_FS_RES_OK) return res;
+    }
+    
+    Py_INCREF(fs);
+    f->fs = fs;
+    fs->stats.opens++;
+    return LV_FS_RES_OK;
+}
+
+/* The open callbacks, one per letter */
+#define FS_OPEN(letter) \
+    static lv_fs_res_t fs_open_##letter(void *file_p, const char *path, lv_fs_mode_t mode) { \
+        return fs_open(#letter[0] - 'A', file_p, path, mode); \
+    }
+FS_OPEN(A) FS_OPEN(B) FS_OPEN(C) FS_OPEN(D) FS_OPEN(E) FS_OPEN(F) FS_OPEN(G)
+FS_OPEN(H) FS_OPEN(I) FS_OPEN(J) FS_OPEN(K) FS_OPEN(L) FS_OPEN(M) FS_OPEN(N)
+FS_OPEN(O) FS_OPEN(P) FS_OPEN(Q) FS_OPEN(R) FS_OPEN(S) FS_OPEN(T) FS_OPEN(U)
+FS_OPEN(V) FS_OPEN(W) FS_OPEN(X) FS_OPEN(Y) FS_OPEN(Z)
+
+static lv_fs_res_t (*const fs_open_cbs[FS_LETTERS])(void *, const char *, lv_fs_mode_t) = {
+    fs_open_A, fs_open_B, fs_open_C, fs_open_D, fs_open_E, fs_open_F, fs_open_G,
+    fs_open_H, fs_open_I, fs_open_J, fs_open_K, fs_open_L, fs_open_M, fs_open_N,
+    fs_open_O, fs_open_P, fs_open_Q, fs_open_R, fs_open_S, fs_open_T, fs_open_U,
+    fs_open_V, fs_open_W, fs_open_X, fs_open_Y, fs_open_Z,
+};
+
+static lv_fs_res_t fs_close(void *file_p) {
+    fs_open_file_t *f = file_p;
+    pylv_FileSystem *fs = f->fs;
+    lv_fs_res_t res = LV_FS_RES_OK;
+    PyObject *result;
+    
+    PyMem_RawFree(f->buf);
+    if (f->fp && fclose(f->fp)) res = fs_errno_res();
+    
+    PyThreadState *prev = interp_enter(fs->interp);
+    if (f->file) {
+        result = PyObject_CallMethod(f->file, "close", NULL);
+        if (result) {
+            Py_DECREF(result);
+        } else {
+            res = fs_error_res();
+        }
+        Py_DECREF(f->file);
+    }
+    Py_DECREF(fs);
+    interp_leave(prev);
+    return res;
+}
+
+/* Release a memoryview of lvgl memory, such that Python code can not access
+ * the memory after the call it was passed to. Keeps a pending exception
+ */
+static void fs_release_view(PyObject *view) {
+    PyObject *type, *value, *traceback, *result;
+    
+    PyErr_Fetch(&type, &value, &traceback);
+    result = PyObject_CallMethod(view, "release", NULL);
+    if (result) {
+        Py_DECREF(result);
+    } else {
+        PyErr_Clear(); // exported by the backend, which should not do that
+    }
+    PyErr_Restore(type, value, traceback);
+    Py_DECREF(view);
+}
+
+/* Read len bytes at pos from the backend into dst. *got is the number of
+ * bytes read, which is less than len only at the end of the file or on an
+ * error
+ */
+static lv_fs_res_t fs_backend_read(fs_open_file_t *f, uint32_t pos, void *dst, uint32_t len, uint32_t *got) {
+    pylv_FileSystem *fs = f->fs;
+    lv_fs_res_t res = LV_FS_RES_OK;
+    PyObject *view, *result;
+    Py_ssize_t n;
+    
+    *got = 0;
+    if (f->fp) {
+        if (f->backend_pos != pos) {
+            fs->stats.backend_seeks++;
+            if (fseek(f->fp, pos, SEEK_SET)) {
+                f->backend_pos = FS_POS_UNKNOWN;
+                return fs_errno_res();
+            }
+        }
+        fs->stats.backend_reads++;
+        *got = fread(dst, 1, len, f->fp);
+        if ((*got < len) && ferror(f->fp)) {
+            clearerr(f->fp);
+            f->backend_pos = FS_POS_UNKNOWN;
+            return LV_FS_RES_FS_ERR;
+        }
+        f->backend_pos = pos + *got;
+        return LV_FS_RES_OK;
+    }
+    
+    PyThreadState *prev = interp_enter(fs->interp);
+    if (f->backend_pos != pos) {
+        fs->stats.backend_seeks++;
+        result = PyObject_CallMethod(f->file, "seek", "I", (unsigned int) pos);
+        if (!result) {
+            res = fs_error_res();
+            f->backend_pos = FS_POS_UNKNOWN;
+            goto done;
+        }
+        Py_DECREF(result);
+    }
+    
+    // readinto may return less than requested before the end of the file,
+    // e.g. for raw files
+    while (*got < len) {
+        view = PyMemoryView_FromMemory((char *) dst + *got, len - *got, PyBUF_WRITE);
+        if (!view) {
+            res = fs_error_res();
+            break;
+        }
+        fs->stats.backend_reads++;
+        result = PyObject_CallMethod(f->file, "readinto", "O", view);
+        fs_release_view(view);
+        if (!result) {
+            res = fs_error_res();
+            break;
+        }
+        n = (result == Py_None) ? -1 : PyLong_AsSsize_t(result); // None: no data available
+        Py_DECREF(result);
+        if ((n < 0) || (n > len - *got)) {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "readinto() returned an invalid size");
+            res = fs_error_res();
+            break;
+        }
+        if (n == 0) break;
+        *got += n;
+    }
+    f->backend_pos = (res == LV_FS_RES_OK) ? pos + *got : FS_POS_UNKNOWN;
+done:
+    interp_leave(prev);
+    return res;
+}
+
+static lv_fs_res_t fs_read(void *file_p, void *buf, uint32_t btr, uint32_t *br) {
+    fs_open_file_t *f = file_p;
+    pylv_FileSystem *fs = f->fs;
+    lv_fs_res_t res = LV_FS_RES_OK;
+    uint32_t n = 0, got;
+    
+    // copy what is in the read-ahead buffer
+    if ((f->pos >= f->buf_pos) && (f->pos - f->buf_pos < f->buf_len)) {
+        n = f->buf_len - (f->pos - f->buf_pos);
+        if (n > btr) n = btr;
+        memcpy(buf, f->buf + (f->pos - f->buf_pos), n);
+        fs->stats.buffered_bytes += n;
+    }
+    
+    if ((n < btr) && (btr - n >= fs->buffer_size)) {
+        // read the rest directly into the lvgl memory
+        res = fs_backend_read(f, f->pos + n, (uint8_t *) buf + n, btr - n, &got);
+        fs->stats.direct_bytes += got;
+        n += got;
+    } else if (n < btr) {
+        // refill the read-ahead buffer
+        if (!f->buf) f->buf = PyMem_RawMalloc(fs->buffer_size);
+        if (f->buf) {
+            f->buf_pos = f->pos + n;
+            res = fs_backend_read(f, f->buf_pos, f->buf, fs->buffer_size, &f->buf_len);
+            got = (f->buf_len < btr - n) ? f->buf_len : btr - n;
+            memcpy((uint8_t *) buf + n, f->buf, got);
+            fs->stats.buffered_bytes += got;
+            n += got;
+        } else {
+            res = LV_FS_RES_OUT_OF_MEM;
+        }
+    }
+    
+    f->pos += n;
+    *br = n;
+    fs->stats.reads++;
+    fs->stats.bytes += n;
+    return res;
+}
+
+static lv_fs_res_t fs_seek(void *file_p, uint32_t pos) {
+    // the backend seeks on the next read, if it is not served by the buffer
+    ((fs_open_file_t *) file_p)->pos = pos;
+    return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t fs_tell(void *file_p, uint32_t *pos_p) {
+    *pos_p = ((fs_open_file_t *) file_p)->pos;
+    return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t fs_size(void *file_p, uint32_t *size_p) {
+    fs_open_file_t *f = file_p;
+    lv_fs_res_t res = LV_FS_RES_OK;
+    PyObject *result;
+    long size;
+    
+    f->fs->stats.backend_seeks++;
+    f->backend_pos = FS_POS_UNKNOWN;
+    if (f->fp) {
+        if (fseek(f->fp, 0, SEEK_END) || ((size = ftell(f->fp)) < 0)) return fs_errno_res();
+        *size_p = f->backend_pos = size;
+        return LV_FS_RES_OK;
+    }
+    
+    PyThreadState *prev = interp_enter(f->fs->interp);
+    result = PyObject_CallMethod(f->file, "seek", "ii", 0, SEEK_END);
+    if (result) {
+        *size_p = PyLong_AsUnsignedLong(result);
+        Py_DECREF(result);
+    }
+    if (PyErr_Occurred()) {
+        res = fs_error_res();
+    } else {
+        f->backend_pos = *size_p;
+    }
+    interp_leave(prev);
+    return res;
+}
+
+/* Must be called with the lvgl lock held */
+static void fs_unregister(pylv_FileSystem *fs) {
+    fs_letters[fs->letter - 'A'] = NULL;
+    fs->registered = false;
+    Py_DECREF(fs);
+}
+
+/* Unregister the filesystems registered in interp, which exits (see
+ * lvgl_atexit). Must be called with the lvgl lock held
+ */
+static void fs_unregister_all(PyInterpreterState *interp) {
+    for (int i = 0; i < FS_LETTERS; i++) {
+        if (fs_letters[i] && (fs_letters[i]->interp == interp)) fs_unregister(fs_letters[i]);
+    }
+}
+
+static int
+FileSystem_init(pylv_FileSystem *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"letter", "backend", "buffer_size", NULL};
+    int letter;
+    PyObject *backend, *path;
+    unsigned int buffer_size = 4096;
+    size_t len;
+    bool in_use = false;
+    lv_fs_drv_t drv;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "CO|I", kwlist, &letter, &backend, &buffer_size)) {
+        return -1;
+    }
+    if (self->root || self->backend) {
+        PyErr_SetString(PyExc_RuntimeError, "FileSystem is already initialized");
+        return -1;
+    }
+    if ((letter < 'A') || (letter > 'Z')) {
+        PyErr_SetString(PyExc_ValueError, "letter must be one of 'A'..'Z'");
+        return -1;
+    }
+    
+    if (PyUnicode_Check(backend) || PyBytes_Check(backend) || PyObject_HasAttrString(backend, "__fspath__")) {
+        if (!PyUnicode_FSConverter(backend, &path)) return -1;
+        len = PyBytes_GET_SIZE(path);
+        self->root = PyMem_Malloc(len + 2);
+        if (!self->root) {
+            Py_DECREF(path);
+            PyErr_NoMemory();
+            return -1;
+        }
+        strcpy(self->root, PyBytes_AS_STRING(path));
+        if (len && (self->root[len - 1] != '/') && (self->root[len - 1] != '\\')) strcat(self->root, "/");
+        Py_DECREF(path);
+    } else if (PyObject_HasAttrString(backend, "open")) {
+        Py_INCREF(backend);
+        self->backend = backend;
+    } else {
+        PyErr_Format(PyExc_TypeError, "backend must be a directory or have an open(path, mode) method, not %.200s", Py_TYPE(backend)->tp_name);
+        return -1;
+    }
+    self->buffer_size = buffer_size;
+    self->interp = PyInterpreterState_Get();
+    
+    LVGL_LOCK
+    if (fs_letters[letter - 'A']) {
+        in_use = true;
+    } else {
+        if (!fs_drv_added[letter - 'A']) {
+            memset(&drv, 0, sizeof(drv));
+            drv.letter = letter;
+            drv.file_size = sizeof(fs_open_file_t);
+            drv.open = fs_open_cbs[letter - 'A'];
+            drv.close = fs_close;
+            drv.read = fs_read;
+            drv.seek = fs_seek;
+            drv.tell = fs_tell;
+            drv.size = fs_size;
+            lv_fs_add_drv(&drv);
+            fs_drv_added[letter - 'A'] = true;
+        }
+        Py_INCREF(self);
+        fs_letters[letter - 'A'] = self;
+    }
+    LVGL_UNLOCK
+    
+    if (in_use) {
+        PyErr_Format(PyExc_ValueError, "drive letter '%c' is already registered", letter);
+        return -1;
+    }
+    self->letter = letter;
+    self->registered = true;
+    return 0;
+}
+
+static void
+FileSystem_dealloc(pylv_FileSystem *self) {
+    PyMem_Free(self->root);
+    Py_XDECREF(self->backend);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+FileSystem_unregister(pylv_FileSystem *self, PyObject *args) {
+    if (!self->registered) {
+        PyErr_SetString(PyExc_RuntimeError, "FileSystem is not registered");
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    fs_unregister(self);
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+FileSystem_stats(pylv_FileSystem *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    fs_stats_t stats;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    stats = self->stats;
+    if (reset) memset(&self->stats, 0, sizeof(self->stats));
+    LVGL_UNLOCK
+    
+    return Py_BuildValue("{sKsKsKsKsKsKsK}",
+        "opens", stats.opens,
+        "reads", stats.reads,
+        "bytes", stats.bytes,
+        "buffered_bytes", stats.buffered_bytes,
+        "direct_bytes", stats.direct_bytes,
+        "backend_reads", stats.backend_reads,
+        "backend_seeks", stats.backend_seeks);
+}
+
+static PyObject *
+FileSystem_get_letter(pylv_FileSystem *self, void *closure) {
+    if (!self->letter) Py_RETURN_NONE;
+    return PyUnicode_FromOrdinal(self->letter);
+}
+
+static PyObject *
+FileSystem_get_backend(pylv_FileSystem *self, void *closure) {
+    if (self->root) return PyUnicode_DecodeFSDefault(self->root);
+    if (!self->backend) Py_RETURN_NONE;
+    Py_INCREF(self->backend);
+    return self->backend;
+}
+
+static PyObject *
+FileSystem_get_buffer_size(pylv_FileSystem *self, void *closure) {
+    return PyLong_FromUnsignedLong(self->buffer_size);
+}
+
+static PyObject *
+FileSystem_get_registered(pylv_FileSystem *self, void *closure) {
+    return PyBool_FromLong(self->registered);
+}
+
+static PyMethodDef FileSystem_methods[] = {
+    {"unregister", (PyCFunction) FileSystem_unregister, METH_NOARGS, "remove the filesystem from its drive letter"},
+    {"stats", (PyCFunction) FileSystem_stats, METH_VARARGS | METH_KEYWORDS, "read statistics"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef FileSystem_getset[] = {
+    {"letter", (getter) FileSystem_get_letter, NULL, "drive letter", NULL},
+    {"backend", (getter) FileSystem_get_backend, NULL, "directory or Python object the files are read from", NULL},
+    {"buffer_size", (getter) FileSystem_get_buffer_size, NULL, "size of the read-ahead buffer of an open file", NULL},
+    {"registered", (getter) FileSystem_get_registered, NULL, "False after unregister()", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_FileSystem_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.FileSystem",
+    .tp_basicsize = sizeof(pylv_FileSystem),
+    .tp_dealloc = (destructor) FileSystem_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "read-only lvgl filesystem for a drive letter",
+    .tp_methods = FileSystem_methods,
+    .tp_getset = FileSystem_getset,
+    .tp_init = (initproc) FileSystem_init,
+    .tp_new = PyType_GenericNew,
+};
+#endif
+
+#if LV_USE_FILESYSTEM
+/* lvgl.ImageDecoder(formats=('png', 'qoi'), fallback=None)
+ *
+ * An lvgl image decoder for file sources (e.g. Img.set_src('S:logo.png')),
+ * which are read through the lvgl filesystem (see lvgl.FileSystem). PNG and
+ * QOI images are decoded natively; the PNG data is inflated by the zlib
+ * module, the rest (unfiltering, conversion) is done here. PNG supports bit
+ * depths 8 and 16, without interlacing. Other files are passed to
+ * fallback(data, src), which returns None if it does not handle the file,
+ * or (width, height, pixels) with pixels a buffer of width * height RGBA
+ * bytes. A registered decoder stays alive until unregister() is called or
+ * its interpreter exits.
+ *
+ * lvgl opens the image every time it is drawn, so the decoded images are
+ * kept in a cache, which is shared by all decoders. The least recently used
+ * images are evicted when the cache exceeds its size in bytes (see
+ * lvgl.set_image_cache_size). Sources which a decoder does not handle are
+ * cached too (without data), as lvgl asks each decoder about every image it
+ * draws.
+ */
+#define IMG_CACHE_DEF_SIZE (4 * 1024 * 1024)
+
+typedef struct img_entry_t {
+    struct img_entry_t *prev, *next; // in img_cache, most recently used first
+    lv_img_decoder_t *decoder;
+    char *src;
+    lv_img_header_t header; // cf is LV_IMG_CF_UNKNOWN if the decoder does not handle src
+    uint8_t *data;
+    size_t size; // bytes accounted to the cache
+    uint32_t users; // opened and not yet closed by lvgl
+    bool cached; // false after eviction or invalidation, freed when no longer used
+} img_entry_t;
+
+/* Protected by the lvgl lock */
+static struct {
+    img_entry_t *head, *tail;
+    size_t size, used;
+    uint32_t entries;
+    uint64_t hits, misses, evictions;
+} img_cache = {.size = IMG_CACHE_DEF_SIZE};
+
+typedef struct pylv_ImageDecoder {
+    PyObject_HEAD
+    lv_img_decoder_t *decoder;
+    PyObject *fallback;
+    PyInterpreterState *interp;
+    bool png, qoi;
+    struct pylv_ImageDecoder *next; // in img_decoders
+} pylv_ImageDecoder;
+
+static PyTypeObject pylv_ImageDecoder_Type;
+
+/* The registered decoders. Protected by the lvgl lock */
+static pylv_ImageDecoder *img_decoders;
+
+static void img_entry_free(img_entry_t *entry) {
+    PyMem_RawFree(entry->data);
+    PyMem_RawFree(entry->src);
+    PyMem_RawFree(entry);
+}
+
+static void img_cache_unlink(img_entry_t *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else img_cache.head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else img_cache.tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void img_cache_link(img_entry_t *entry) {
+    entry->next = img_cache.head;
+    if (img_cache.head) img_cache.head->prev = entry;
+    else img_cache.tail = entry;
+    img_cache.head = entry;
+}
+
+static void img_cache_insert(img_entry_t *entry) {
+    img_cache_link(entry);
+    entry->cached = true;
+    img_cache.used += entry->size;
+    img_cache.entries++;
+}
+
+static void img_cache_remove(img_entry_t *entry) {
+    img_cache_unlink(entry);
+    entry->cached = false;
+    img_cache.used -= entry->size;
+    img_cache.entries--;
+    if (!entry->users) img_entry_free(entry);
+}
+
+/* Evict the least recently used entries which are not in use, except keep,
+ * until the cache fits its size
+ */
+static void img_cache_trim(img_entry_t *keep) {
+    img_entry_t *entry, *prev;
+    
+    for (entry = img_cache.tail; entry && (img_cache.used > img_cache.size); entry = prev) {
+        prev = entry->prev;
+        if (entry->users || (entry == keep)) continue;
+        img_cache_remove(entry);
+        img_cache.evictions++;
+    }
+}
+
+/* Allocate the pixels of entry, in the lvgl true color format. Returns the
+ * bytes per pixel, or 0 with an exception set
+ */
+static size_t img_alloc(img_entry_t *entry, uint32_t w, uint32_t h, bool alpha) {
+    size_t px_size = alpha ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t);
+    
+    // lv_img_header_t has 11 bits for the width and height
+    if (!w || !h || (w > 2047) || (h > 2047)) {
+        PyErr_Format(PyExc_ValueError, "unsupported image size %ux%u", w, h);
+        return 0;
+    }
+    entry->data = PyMem_RawMalloc(w * h * px_size);
+    if (!entry->data) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    entry->header.cf = alpha ? LV_IMG_CF_TRUE_COLOR_ALPHA : LV_IMG_CF_TRUE_COLOR;
+    entry->header.w = w;
+    entry->header.h = h;
+    entry->size += w * h * px_size;
+    return px_size;
+}
+
+static inline void img_put_px(uint8_t *dst, bool alpha, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    lv_color_t color = LV_COLOR_MAKE(r, g, b);
+    
+    memcpy(dst, &color, sizeof(color));
+    if (alpha) dst[sizeof(color)] = a;
+}
+
+static inline uint32_t img_be32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint8_t img_paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    
+    if ((pa <= pb) && (pa <= pc)) return a;
+    return (pb <= pc) ? b : c;
+}
+
+static const uint8_t img_png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+static int img_decode_png(const uint8_t *data, size_t size, img_entry_t *entry) {
+    const uint8_t *p = data + 8, *end = data + size, *body, *plte = NULL, *row, *px;
+    uint32_t len, w = 0, h = 0, plte_n = 0, x, y, i;
+    int depth = 0, ctype = -1, interlace = 0, channels, sample;
+    uint16_t trns[3];
+    uint8_t palpha[256], *rows = NULL, *cur, *prev, *tmp, *dst, a, b, c, r, g, bl, al;
+    bool has_trns = false, alpha;
+    size_t bpp, stride, px_size;
+    Py_ssize_t n;
+    PyObject *idat, *zlib = NULL, *decompressor = NULL, *raw = NULL;
+    int ret = -1;
+    
+    memset(palpha, 0xff, sizeof(palpha));
+    idat = PyByteArray_FromStringAndSize(NULL, 0);
+    if (!idat) return -1;
+    
+    // Collect the header, palette, transparency and the image data chunks
+    while (end - p >= 12) {
+        len = img_be32(p);
+        body = p + 8;
+        if (len > (size_t) (end - body - 4)) break;
+        if (!memcmp(p + 4, "IHDR", 4) && (len >= 13)) {
+            w = img_be32(body);
+            h = img_be32(body + 4);
+            depth = body[8];
+            ctype = body[9];
+            interlace = body[12];
+        } else if (!memcmp(p + 4, "PLTE", 4)) {
+            plte = body;
+            plte_n = len / 3;
+        } else if (!memcmp(p + 4, "tRNS", 4)) {
+            if (ctype == 3) {
+                memcpy(palpha, body, (len < 256) ? len : 256);
+            } else if ((ctype == 0) || (ctype == 2)) {
+                for (i = 0; (i < 3) && (2 * i + 1 < len); i++) trns[i] = (body[2 * i] << 8) | body[2 * i + 1];
+                has_trns = (len >= ((ctype == 0) ? 2 : 6));
+            }
+        } else if (!memcmp(p + 4, "IDAT", 4)) {
+            n = PyByteArray_GET_SIZE(idat);
+            if (PyByteArray_Resize(idat, n + len)) goto error;
+            memcpy(PyByteArray_AS_STRING(idat) + n, body, len);
+        } else if (!memcmp(p + 4, "IEND", 4)) {
+            break;
+        }
+        p = body + len + 4;
+    }
+    
+    switch (ctype) {
+        case 0: channels = 1; break;
+        case 2: channels = 3; break;
+        case 3: channels = 1; break;
+        case 4: channels = 2; break;
+        case 6: channels = 4; break;
+        default: channels = 0;
+    }
+    if (!channels || ((depth != 8) && ((depth != 16) || (ctype == 3))) || interlace || ((ctype == 3) && !plte)) {
+        PyErr_Format(PyExc_ValueError, "unsupported PNG (color type %d, bit depth %d, interlace %d)", ctype, depth, interlace);
+        goto error;
+    }
+    bpp = channels * depth / 8;
+    stride = (size_t) w * bpp;
+    alpha = (ctype == 4) || (ctype == 6) || has_trns;
+    for (i = 0; (ctype == 3) && (i < plte_n); i++) alpha |= (palpha[i] != 0xff);
+    
+    // checks the size, before stride is used
+    px_size = img_alloc(entry, w, h, alpha);
+    if (!px_size) goto error;
+    
+    // The output is limited to the expected size, so a small crafted image
+    // cannot inflate to gigabytes
+    zlib = PyImport_ImportModule("zlib");
+    if (!zlib) goto error;
+    decompressor = PyObject_CallMethod(zlib, "decompressobj", NULL);
+    if (!decompressor) goto error;
+    raw = PyObject_CallMethod(decompressor, "decompress", "On", idat, (Py_ssize_t) ((stride + 1) * h));
+    if (!raw) goto error;
+    if ((size_t) PyBytes_GET_SIZE(raw) < (stride + 1) * h) {
+        PyErr_SetString(PyExc_ValueError, "truncated PNG image data");
+        goto error;
+    }
+    
+    rows = PyMem_RawCalloc(2, stride);
+    if (!rows) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    prev = rows;
+    cur = rows + stride;
+    row = (const uint8_t *) PyBytes_AS_STRING(raw);
+    dst = entry->data;
+    sample = depth / 8; // the first (most significant) byte of a sample is used
+    
+    for (y = 0; y < h; y++, row += stride + 1) {
+        // Undo the filter of the row, which refers to the previous row
+        for (i = 0; i < stride; i++) {
+            a = (i >= bpp) ? cur[i - bpp] : 0;
+            b = prev[i];
+            c = (i >= bpp) ? prev[i - bpp] : 0;
+            switch (row[0]) {
+                case 0: cur[i] = row[1 + i]; break;
+                case 1: cur[i] = row[1 + i] + a; break;
+                case 2: cur[i] = row[1 + i] + b; break;
+                case 3: cur[i] = row[1 + i] + ((a + b) >> 1); break;
+                case 4: cur[i] = row[1 + i] + img_paeth(a, b, c); break;
+                default:
+                    PyErr_Format(PyExc_ValueError, "invalid PNG filter type %d", row[0]);
+                    goto error;
+            }
+        }
+        
+        for (x = 0, px = cur; x < w; x++, px += bpp, dst += px_size) {
+            al = 0xff;
+            switch (ctype) {
+                case 0:
+                    r = g = bl = px[0];
+                    if (has_trns && (((depth == 16) ? (px[0] << 8 | px[1]) : px[0]) == trns[0])) al = 0;
+                    break;
+                case 2:
+                    r = px[0];
+                    g = px[sample];
+                    bl = px[2 * sample];
+                    if (has_trns && ((depth == 16) ?
+                            ((px[0] << 8 | px[1]) == trns[0]) && ((px[2] << 8 | px[3]) == trns[1]) && ((px[4] << 8 | px[5]) == trns[2]) :
+                            (px[0] == trns[0]) && (px[1] == trns[1]) && (px[2] == trns[2]))) al = 0;
+                    break;
+                case 3:
+                    if (px[0] < plte_n) {
+                        r = plte[3 * px[0]];
+                        g = plte[3 * px[0] + 1];
+                        bl = plte[3 * px[0] + 2];
+                    } else {
+                        r = g = bl = 0;
+                    }
+                    al = palpha[px[0]];
+                    break;
+                case 4:
+                    r = g = bl = px[0];
+                    al = px[sample];
+                    break;
+                default:
+                    r = px[0];
+                    g = px[sample];
+                    bl = px[2 * sample];
+                    al = px[3 * sample];
+            }
+            img_put_px(dst, alpha, r, g, bl, al);
+        }
+        
+        tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    ret = 0;
+    
+error:
+    PyMem_RawFree(rows);
+    Py_XDECREF(raw);
+    Py_XDECREF(decompressor);
+    Py_XDECREF(zlib);
+    Py_DECREF(idat);
+    return ret;
+}
+
+/* See https://qoiformat.org/qoi-specification.pdf */
+static int img_decode_qoi(const uint8_t *data, size_t size, img_entry_t *entry) {
+    const uint8_t *p = data + 14, *end = data + size;
+    uint8_t index[64][4], px[4] = {0, 0, 0, 0xff}, b1, b2, *dst;
+    uint32_t w, h, i, run = 0;
+    int vg;
+    bool alpha;
+    size_t px_size;
+    
+    if (size < 14) {
+        PyErr_SetString(PyExc_ValueError, "truncated QOI header");
+        return -1;
+    }
+    w = img_be32(data + 4);
+    h = img_be32(data + 8);
+    alpha = (data[12] == 4);
+    px_size = img_alloc(entry, w, h, alpha);
+    if (!px_size) return -1;
+    
+    memset(index, 0, sizeof(index));
+    for (i = 0, dst = entry->data; i < w * h; i++, dst += px_size) {
+        if (run) {
+            run--;
+        } else {
+            if (p >= end) goto truncated;
+            b1 = *p++;
+            if (b1 == 0xfe) { // QOI_OP_RGB
+                if (end - p < 3) goto truncated;
+                memcpy(px, p, 3);
+                p += 3;
+            } else if (b1 == 0xff) { // QOI_OP_RGBA
+                if (end - p < 4) goto truncated;
+                memcpy(px, p, 4);
+                p += 4;
+            } else if ((b1 & 0xc0) == 0x00) { // QOI_OP_INDEX
+                memcpy(px, index[b1], 4);
+            } else if ((b1 & 0xc0) == 0x40) { // QOI_OP_DIFF
+                px[0] += ((b1 >> 4) & 0x03) - 2;
+                px[1] += ((b1 >> 2) & 0x03) - 2;
+                px[2] += (b1 & 0x03) - 2;
+            } else if ((b1 & 0xc0) == 0x80) { // QOI_OP_LUMA
+                if (p >= end) goto truncated;
+                b2 = *p++;
+                vg = (b1 & 0x3f) - 32;
+                px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 + (b2 & 0x0f);
+            } else { // QOI_OP_RUN
+                run = b1 & 0x3f;
+            }
+            memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        }
+        img_put_px(dst, alpha, px[0], px[1], px[2], px[3]);
+    }
+    return 0;
+    
+truncated:
+    PyErr_SetString(PyExc_ValueError, "truncated QOI image data");
+    return -1;
+}
+
+/* Convert the (width, height, pixels) returned by a fallback decoder */
+static int img_from_rgba(PyObject *result, img_entry_t *entry) {
+    unsigned int w, h;
+    PyObject *pixels;
+    Py_buffer view;
+    const uint8_t *src;
+    uint8_t *dst;
+    bool alpha = false;
+    size_t px_size, i;
+    
+    if (!PyArg_ParseTuple(result, "IIO;fallback must return None or (width, height, pixels)", &w, &h, &pixels)) return -1;
+    if (PyObject_GetBuffer(pixels, &view, PyBUF_SIMPLE)) return -1;
+    if ((size_t) view.len != (size_t) w * h * 4) {
+        PyErr_Format(PyExc_ValueError, "pixels must be %zu bytes (RGBA), not %zd", (size_t) w * h * 4, view.len);
+        PyBuffer_Release(&view);
+        return -1;
+    }
+    src = view.buf;
+    for (i = 0; (i < (size_t) w * h) && !alpha; i++) alpha = (src[4 * i + 3] != 0xff);
+    
+    px_size = img_alloc(entry, w, h, alpha);
+    if (px_size) {
+        for (i = 0, dst = entry->data; i < (size_t) w * h; i++, src += 4, dst += px_size) {
+            img_put_px(dst, alpha, src[0], src[1], src[2], src[3]);
+        }
+    }
+    PyBuffer_Release(&view);
+    return px_size ? 0 : -1;
+}
+
+/* Read the file through the lvgl filesystem. Returns NULL without an
+ * exception set if the file can not be read
+ */
+static PyObject *img_read_file(lv_fs_file_t *file) {
+    uint32_t size, br;
+    PyObject *data;
+    
+    if ((lv_fs_size(file, &size) != LV_FS_RES_OK) || (lv_fs_seek(file, 0) != LV_FS_RES_OK)) return NULL;
+    data = PyBytes_FromStringAndSize(NULL, size);
+    if (!data) return NULL;
+    if ((lv_fs_read(file, PyBytes_AS_STRING(data), size, &br) != LV_FS_RES_OK) || (br != size)) Py_CLEAR(data);
+    return data;
+}
+
+/* Decode the file src into entry. If the decoder does not handle it, or
+ * decoding fails, entry is left without data. Errors are printed as for
+ * event callbacks
+ */
+static void img_decode(pylv_ImageDecoder *self, const char *src, img_entry_t *entry) {
+    lv_fs_file_t file;
+    uint8_t magic[8];
+    uint32_t br;
+    bool png, qoi;
+    PyObject *data, *result;
+    int ret = -1;
+    
+    if (lv_fs_open(&file, src, LV_FS_MODE_RD) != LV_FS_RES_OK) return;
+    if (lv_fs_read(&file, magic, sizeof(magic), &br) != LV_FS_RES_OK) br = 0;
+    png = self->png && (br == 8) && !memcmp(magic, img_png_signature, 8);
+    qoi = self->qoi && (br >= 4) && !memcmp(magic, "qoif", 4);
+    if (!png && !qoi && !self->fallback) {
+        lv_fs_close(&file);
+        return;
+    }
+    
+    PyThreadState *prev = interp_enter(self->interp);
+    data = img_read_file(&file);
+    lv_fs_close(&file);
+    if (data) {
+        if (png) ret = img_decode_png((uint8_t *) PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data), entry);
+        if (qoi) ret = img_decode_qoi((uint8_t *) PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data), entry);
+        if (ret && self->fallback) {
+            // e.g. an unsupported PNG variant
+            PyErr_Clear();
+            result = PyObject_CallFunction(self->fallback, "Os", data, src);
+            if (result == Py_None) {
+                ret = 0;
+            } else if (result) {
+                ret = img_from_rgba(result, entry);
+            }
+            Py_XDECREF(result);
+        }
+        Py_DECREF(data);
+    }
+    if (PyErr_Occurred()) {
+        PyErr_Print();
+        PyErr_Clear();
+    }
+    if (ret && entry->data) {
+        PyMem_RawFree(entry->data);
+        entry->data = NULL;
+    }
+    if (!entry->data) entry->header.cf = LV_IMG_CF_UNKNOWN;
+    interp_leave(prev);
+}
+
+/* Return the cache entry of src, decoding it on a miss. Must be called with
+ * the lvgl lock held
+ */
+static img_entry_t *img_cache_get(lv_img_decoder_t *decoder, const char *src) {
+    img_entry_t *entry;
+    
+    for (entry = img_cache.head; entry; entry = entry->next) {
+        if ((entry->decoder == decoder) && !strcmp(entry->src, src)) break;
+    }
+    if (entry) {
+        img_cache.hits++;
+        img_cache_unlink(entry);
+        img_cache_link(entry);
+        return entry;
+    }
+    
+    img_cache.misses++;
+    entry = PyMem_RawCalloc(1, sizeof(img_entry_t));
+    if (!entry) return NULL;
+    entry->src = PyMem_RawMalloc(strlen(src) + 1);
+    if (!entry->src) {
+        PyMem_RawFree(entry);
+        return NULL;
+    }
+    strcpy(entry->src, src);
+    entry->decoder = decoder;
+    entry->size = sizeof(img_entry_t) + strlen(src) + 1;
+    img_decode(decoder->user_data, src, entry);
+    
+    img_cache_insert(entry);
+    img_cache_trim(entry);
+    return entry;
+}
+
+static lv_res_t img_decoder_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header) {
+    img_entry_t *entry;
+    
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_FILE) return LV_RES_INV;
+    entry = img_cache_get(decoder, src);
+    if (!entry || !entry->data) return LV_RES_INV;
+    *header = entry->header;
+    return LV_RES_OK;
+}
+
+static const uint8_t *img_decoder_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc) {
+    img_entry_t *entry;
+    
+    dsc->user_data = NULL;
+    if (lv_img_src_get_type(dsc->src) != LV_IMG_SRC_FILE) return LV_IMG_DECODER_OPEN_FAIL;
+    entry = img_cache_get(decoder, dsc->src);
+    if (!entry || !entry->data) return LV_IMG_DECODER_OPEN_FAIL;
+    
+    // keep the data until close, even if it is evicted meanwhile
+    entry->users++;
+    dsc->user_data = entry;
+    return entry->data;
+}
+
+static void img_decoder_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc) {
+    img_entry_t *entry = dsc->user_data;
+    
+    if (!entry) return;
+    dsc->user_data = NULL;
+    entry->users--;
+    if (!entry->cached && !entry->users) img_entry_free(entry);
+    else img_cache_trim(NULL);
+}
+
+/* Remove the entries of decoder (NULL: all) and src (NULL: all) from the
+ * cache. Returns the number of entries removed. Must be called with the lvgl
+ * lock held
+ */
+static uint32_t img_cache_invalidate(lv_img_decoder_t *decoder, const char *src) {
+    img_entry_t *entry, *next;
+    uint32_t n = 0;
+    
+    for (entry = img_cache.head; entry; entry = next) {
+        next = entry->next;
+        if (decoder && (entry->decoder != decoder)) continue;
+        if (src && strcmp(entry->src, src)) continue;
+        img_cache_remove(entry);
+        n++;
+    }
+    return n;
+}
+
+/* Must be called with the lvgl lock held */
+static void img_decoder_unregister(pylv_ImageDecoder *self) {
+    pylv_ImageDecoder **p;
+    
+    for (p = &img_decoders; *p != self; p = &(*p)->next);
+    *p = self->next;
+    img_cache_invalidate(self->decoder, NULL);
+    lv_img_decoder_delete(self->decoder);
+    self->decoder = NULL;
+    Py_DECREF(self);
+}
+
+/* Unregister the decoders registered in interp, which exits (see
+ * lvgl_atexit). Must be called with the lvgl lock held
+ */
+static void img_decoder_unregister_all(PyInterpreterState *interp) {
+    pylv_ImageDecoder *self, *next;
+    
+    for (self = img_decoders; self; self = next) {
+        next = self->next;
+        if (self->interp == interp) img_decoder_unregister(self);
+    }
+}
+
+static int
+ImageDecoder_init(pylv_ImageDecoder *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"formats", "fallback", NULL};
+    PyObject *formats = NULL, *fallback = Py_None, *seq;
+    const char *format;
+    bool png = true, qoi = true;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO", kwlist, &formats, &fallback)) {
+        return -1;
+    }
+    if (self->interp) {
+        PyErr_SetString(PyExc_RuntimeError, "ImageDecoder is already initialized");
+        return -1;
+    }
+    if (formats) {
+        seq = PySequence_Fast(formats, "formats must be a sequence of format names");
+        if (!seq) return -1;
+        png = qoi = false;
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+            format = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+            if (format && !strcmp(format, "png")) png = true;
+            else if (format && !strcmp(format, "qoi")) qoi = true;
+            else {
+                if (format) PyErr_Format(PyExc_ValueError, "unknown image format '%s'", format);
+                Py_DECREF(seq);
+                return -1;
+            }
+        }
+        Py_DECREF(seq);
+    }
+    if ((fallback != Py_None) && !PyCallable_Check(fallback)) {
+        PyErr_SetString(PyExc_TypeError, "fallback must be callable or None");
+        return -1;
+    }
+    
+    self->png = png;
+    self->qoi = qoi;
+    if (fallback != Py_None) {
+        Py_INCREF(fallback);
+        self->fallback = fallback;
+    }
+    self->interp = PyInterpreterState_Get();
+    
+    LVGL_LOCK
+    self->decoder = lv_img_decoder_create();
+    if (self->decoder) {
+        lv_img_decoder_set_info_cb(self->decoder, img_decoder_info);
+        lv_img_decoder_set_open_cb(self->decoder, img_decoder_open);
+        lv_img_decoder_set_close_cb(self->decoder, img_decoder_close);
+        self->decoder->user_data = self;
+        Py_INCREF(self);
+        self->next = img_decoders;
+        img_decoders = self;
+    }
+    LVGL_UNLOCK
+    
+    if (!self->decoder) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void
+ImageDecoder_dealloc(pylv_ImageDecoder *self) {
+    Py_XDECREF(self->fallback);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+ImageDecoder_unregister(pylv_ImageDecoder *self, PyObject *args) {
+    if (!self->decoder) {
+        PyErr_SetString(PyExc_RuntimeError, "ImageDecoder is not registered");
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    img_decoder_unregister(self);
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+ImageDecoder_get_formats(pylv_ImageDecoder *self, void *closure) {
+    if (self->png && self->qoi) return Py_BuildValue("(ss)", "png", "qoi");
+    if (self->png) return Py_BuildValue("(s)", "png");
+    if (self->qoi) return Py_BuildValue("(s)", "qoi");
+    return PyTuple_New(0);
+}
+
+static PyObject *
+ImageDecoder_get_fallback(pylv_ImageDecoder *self, void *closure) {
+    if (!self->fallback) Py_RETURN_NONE;
+    Py_INCREF(self->fallback);
+    return self->fallback;
+}
+
+static PyObject *
+ImageDecoder_get_registered(pylv_ImageDecoder *self, void *closure) {
+    return PyBool_FromLong(self->decoder != NULL);
+}
+
+static PyMethodDef ImageDecoder_methods[] = {
+    {"unregister", (PyCFunction) ImageDecoder_unregister, METH_NOARGS, "remove the decoder and its cached images"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef ImageDecoder_getset[] = {
+    {"formats", (getter) ImageDecoder_get_formats, NULL, "formats decoded natively", NULL},
+    {"fallback", (getter) ImageDecoder_get_fallback, NULL, "function called as fallback(data, src) for other files", NULL},
+    {"registered", (getter) ImageDecoder_get_registered, NULL, "False after unregister()", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_ImageDecoder_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.ImageDecoder",
+    .tp_basicsize = sizeof(pylv_ImageDecoder),
+    .tp_dealloc = (destructor) ImageDecoder_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "lvgl image decoder for PNG, QOI and Python-decoded files",
+    .tp_methods = ImageDecoder_methods,
+    .tp_getset = ImageDecoder_getset,
+    .tp_init = (initproc) ImageDecoder_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* lvgl.set_image_cache_size(nbytes): the size of the decoded image cache */
+static PyObject *
+set_image_cache_size(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"nbytes", NULL};
+    Py_ssize_t nbytes;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &nbytes)) {
+        return NULL;
+    }
+    if (nbytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "nbytes must be non-negative");
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    img_cache.size = nbytes;
+    img_cache_trim(NULL);
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+image_cache_info(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    ret = Py_BuildValue("{snsnsIsKsKsK}",
+        "size", (Py_ssize_t) img_cache.size,
+        "used", (Py_ssize_t) img_cache.used,
+        "entries", img_cache.entries,
+        "hits", img_cache.hits,
+        "misses", img_cache.misses,
+        "evictions", img_cache.evictions);
+    if (ret && reset) img_cache.hits = img_cache.misses = img_cache.evictions = 0;
+    LVGL_UNLOCK
+    
+    return ret;
+}
+
+/* lvgl.image_cache_invalidate(src=None): remove src (None: all images) from
+ * the cache, e.g. after the file has changed. Returns the number of entries
+ * removed
+ */
+static PyObject *
+pylv_image_cache_invalidate(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"src", NULL};
+    const char *src = NULL;
+    uint32_t n;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|z", kwlist, &src)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    n = img_cache_invalidate(NULL, src);
+    LVGL_UNLOCK
+    
+    return PyLong_FromUnsignedLong(n);
+}
+#endif
+
+/* Registered with atexit: a scheduled task, running animation, registered
+ * filesystem or image decoder keeps its callback or backend, and with it
+ * often the module, alive, so they are removed when the interpreter exits
+ */
+static PyObject *
+lvgl_atexit(PyObject *self, PyObject *args) {
+    LVGL_LOCK
+    task_delete_all(PyInterpreterState_Get());
+#if LV_USE_ANIMATION
+    anim_stop_all(PyInterpreterState_Get());
+#endif
+#if LV_USE_FILESYSTEM
+    fs_unregister_all(PyInterpreterState_Get());
+    img_decoder_unregister_all(PyInterpreterState_Get());
+#endif
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+<<GLOBAL_FUNCTIONS>>
+static PyMethodDef Task_methods[] = {
+    {"del_", (PyCFunction) Task_del, METH_NOARGS, "delete the task"},
+    {"reset", (PyCFunction) Task_reset, METH_NOARGS, "restart the current period"},
+    PYLV_TASK_METHODS
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef Task_getset[] = {
+    {"period", (getter) Task_get_period, NULL, "period in ms, see set_period", NULL},
+    {"callback", (getter) Task_get_callback, (setter) Task_set_callback, "function called as callback(task)", NULL},
+    {"missed", (getter) Task_get_missed, NULL, "number of periods missed before the last run", NULL},
+    {"active", (getter) Task_get_active, NULL, "False when the task has been deleted", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_Task_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.Task",
+    .tp_basicsize = sizeof(pylv_Task),
+    .tp_dealloc = (destructor) Task_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_doc = "lvgl task which calls callback(task) every period ms",
+    .tp_traverse = (traverseproc) Task_traverse,
+    .tp_clear = (inquiry) Task_clear,
+    .tp_methods = Task_methods,
+    .tp_getset = Task_getset,
+    .tp_init = (initproc) Task_init,
+    .tp_new = PyType_GenericNew,
+};
+
+#if LV_USE_ANIMATION
+static PyMethodDef Anim_methods[] = {
+    {"start", (PyCFunction) Anim_start, METH_NOARGS, "start the animation, replacing a running animation of the same property"},
+    {"stop", (PyCFunction) Anim_stop, METH_NOARGS, "stop the animation, without calling ready_cb"},
+    {"set_path", (PyCFunction) Anim_set_path, METH_VARARGS | METH_KEYWORDS, "set the animation path, one of ANIM_PATH"},
+    PYLV_ANIM_METHODS
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef Anim_getset[] = {
+    {"running", (getter) Anim_get_running, NULL, "True while the animation runs", NULL},
+    {"target", (getter) Anim_get_target, NULL, "the animated Obj or style_t", NULL},
+    {"ready_cb", (getter) Anim_get_ready_cb, (setter) Anim_set_ready_cb, "function called as ready_cb(anim) when the animation completes", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_Anim_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.Anim",
+    .tp_basicsize = sizeof(pylv_Anim),
+    .tp_dealloc = (destructor) Anim_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_doc = "animation of an object property or style field, run natively by lvgl",
+    .tp_traverse = (traverseproc) Anim_traverse,
+    .tp_clear = (inquiry) Anim_clear,
+    .tp_methods = Anim_methods,
+    .tp_getset = Anim_getset,
+    .tp_init = (initproc) Anim_init,
+    .tp_new = PyType_GenericNew,
+};
+#endif
+
+#if LV_USE_GROUP
+static PyMethodDef Group_methods[] = {
+    {"del_", (PyCFunction) Group_del, METH_NOARGS, "delete the group"},
+    PYLV_GROUP_METHODS
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_Group_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.Group",
+    .tp_basicsize = sizeof(pylv_Group),
+    .tp_dealloc = (destructor) Group_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "lvgl focus group, navigated by keypad and encoder input devices",
+    .tp_methods = Group_methods,
+    .tp_init = (initproc) Group_init,
+    .tp_new = PyType_GenericNew,
+};
+#endif
+
+/****************************************************************
+ *  Themes                                                      *
+ ****************************************************************/
+
+/* lvgl.Theme(name, hue=210, font=None)
+ *
+ * A built-in theme ('default', 'alien', 'night', ...), initialized for hue
+ * (0..360) and font (a font_t, None for the default font). The theme init
+ * functions keep their styles in static storage, which the next init of the
+ * same theme overwrites, so the styles are copied into a style set owned by
+ * the Theme. apply() makes it the current theme without initializing it
+ * again, so switching between Theme objects is cheap.
+ *
+ * With LV_THEME_LIVE_UPDATE (setup.py with LVGL_THEME_LIVE_UPDATE=1), the
+ * objects use lvgl's copy of the current theme's styles, so apply() re-themes
+ * the existing objects as well. Otherwise only objects created afterwards
+ * get the new theme, and they refer to the styles of the Theme, which
+ * therefore is never freed once applied.
+ */
+typedef lv_theme_t *(*theme_init_t)(uint16_t hue, lv_font_t *font);
+
+static const struct {
+    const char *name;
+    theme_init_t init;
+} theme_inits[] = {
+#if LV_USE_THEME_DEFAULT
+    {"default", lv_theme_default_init},
+#endif
+#if LV_USE_THEME_TEMPL
+    {"templ", lv_theme_templ_init},
+#endif
+#if LV_USE_THEME_ALIEN
+    {"alien", lv_theme_alien_init},
+#endif
+#if LV_USE_THEME_NIGHT
+    {"night", lv_theme_night_init},
+#endif
+#if LV_USE_THEME_MONO
+    {"mono", lv_theme_mono_init},
+#endif
+#if LV_USE_THEME_MATERIAL
+    {"material", lv_theme_material_init},
+#endif
+#if LV_USE_THEME_ZEN
+    {"zen", lv_theme_zen_init},
+#endif
+#if LV_USE_THEME_NEMO
+    {"nemo", lv_theme_nemo_init},
+#endif
+    {NULL}
+};
+
+// The styles of a theme are an array of lv_style_t pointers (as in lv_theme.c)
+#define THEME_STYLE_NUM (sizeof(((lv_theme_t *)0)->style) / sizeof(lv_style_t *))
+
+typedef struct {
+    PyObject_HEAD
+    lv_theme_t theme; // refers to styles
+    lv_style_t styles[THEME_STYLE_NUM];
+    const char *name;
+    uint16_t hue;
+    PyObject *font;
+    bool pinned; // applied without LV_THEME_LIVE_UPDATE, see above
+} pylv_Theme;
+
+static PyTypeObject pylv_Theme_Type;
+
+static int
+Theme_init(pylv_Theme *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "hue", "font", NULL};
+    const char *name;
+    unsigned int hue = 210;
+    PyObject *font = Py_None;
+    lv_theme_t *theme;
+    lv_style_t **src, **dst;
+    int i;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|IO", kwlist, &name, &hue, &font)) {
+        return -1;
+    }
+    if (self->name) {
+        PyErr_SetString(PyExc_RuntimeError, "Theme is already initialized");
+        return -1;
+    }
+    for (i = 0; theme_inits[i].name && strcmp(theme_inits[i].name, name); i++);
+    if (!theme_inits[i].name) {
+        PyErr_Format(PyExc_ValueError, "unknown theme '%s'", name);
+        return -1;
+    }
+    if (hue > 360) {
+        PyErr_Format(PyExc_ValueError, "hue must be in 0..360, not %u", hue);
+        return -1;
+    }
+    if ((font != Py_None) && !PyObject_TypeCheck(font, &pylv_font_t_Type)) {
+        PyErr_Format(PyExc_TypeError, "font must be a font_t or None, not %.200s", Py_TYPE(font)->tp_name);
+        return -1;
+    }
+    
+    LVGL_LOCK
+    theme = theme_inits[i].init(hue, (font == Py_None) ? NULL : (lv_font_t *) ((StructObject *) font)->data);
+    self->theme = *theme;
+    src = (lv_style_t **) &theme->style;
+    dst = (lv_style_t **) &self->theme.style;
+    for (size_t j = 0; j < THEME_STYLE_NUM; j++) {
+        if (!src[j]) continue;
+        self->styles[j] = *src[j];
+        dst[j] = &self->styles[j];
+    }
+    LVGL_UNLOCK
+    
+    // the styles refer to the font
+    if (font != Py_None) {
+        Py_INCREF(font);
+        self->font = font;
+    }
+    self->name = theme_inits[i].name;
+    self->hue = hue;
+    return 0;
+}
+
+static int check_theme(pylv_Theme *self) {
+    if (!self->name) {
+        PyErr_SetString(PyExc_RuntimeError, "Theme is not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+static void
+Theme_dealloc(pylv_Theme *self) {
+    Py_XDECREF(self->font);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+Theme_apply(pylv_Theme *self, PyObject *args) {
+    lvgl_state *state = get_state();
+    
+    if (!state) return NULL;
+    if (check_theme(self)) return NULL;
+    
+    LVGL_LOCK
+    lv_theme_set_current(&self->theme);
+    LVGL_UNLOCK
+    
+#if LV_THEME_LIVE_UPDATE == 0
+    if (!self->pinned) {
+        Py_INCREF(self);
+        self->pinned = true;
+    }
+#endif
+    Py_INCREF(self);
+    Py_XSETREF(state->theme, (PyObject *) self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Theme_get_name(pylv_Theme *self, void *closure) {
+    if (check_theme(self)) return NULL;
+    return PyUnicode_FromString(self->name);
+}
+
+static PyObject *
+Theme_get_hue(pylv_Theme *self, void *closure) {
+    return PyLong_FromLong(self->hue);
+}
+
+static PyObject *
+Theme_get_font(pylv_Theme *self, void *closure) {
+    if (!self->font) Py_RETURN_NONE;
+    Py_INCREF(self->font);
+    return self->font;
+}
+
+static PyMethodDef Theme_methods[] = {
+    {"apply", (PyCFunction) Theme_apply, METH_NOARGS, "make this the current theme"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef Theme_getset[] = {
+    {"name", (getter) Theme_get_name, NULL, "name of the built-in theme", NULL},
+    {"hue", (getter) Theme_get_hue, NULL, "hue the theme was initialized for", NULL},
+    {"font", (getter) Theme_get_font, NULL, "font the theme was initialized for, None for the default font", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_Theme_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.Theme",
+    .tp_basicsize = sizeof(pylv_Theme),
+    .tp_dealloc = (destructor) Theme_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "built-in lvgl theme with its own set of styles",
+    .tp_methods = Theme_methods,
+    .tp_getset = Theme_getset,
+    .tp_init = (initproc) Theme_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* lvgl.set_theme(name, hue=210, font=None): apply the theme, using the Theme
+ * made by an earlier call with the same arguments if there is one. Returns
+ * the Theme
+ */
+static PyObject *
+set_theme(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "hue", "font", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    const char *name;
+    unsigned int hue = 210;
+    PyObject *font = Py_None, *key, *theme, *result;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|IO", kwlist, &name, &hue, &font)) {
+        return NULL;
+    }
+    if (PyType_Ready(&pylv_Theme_Type) < 0) return NULL;
+    
+    key = Py_BuildValue("sIO", name, hue, font);
+    if (!key) return NULL;
+    theme = PyDict_GetItemWithError(state->themes, key); // borrowed reference
+    if (theme) {
+        Py_INCREF(theme);
+    } else if (!PyErr_Occurred()) {
+        theme = PyObject_CallFunction((PyObject *) &pylv_Theme_Type, "sIO", name, hue, font);
+        if (theme && PyDict_SetItem(state->themes, key, theme)) Py_CLEAR(theme);
+    }
+    Py_DECREF(key);
+    if (!theme) return NULL;
+    
+    result = Theme_apply((pylv_Theme *) theme, NULL);
+    if (!result) {
+        Py_DECREF(theme);
+        return NULL;
+    }
+    Py_DECREF(result);
+    return theme;
+}
+
+static PyObject *
+get_theme(PyObject *self, PyObject *args) {
+    lvgl_state *state = PyModule_GetState(self);
+    
+    if (!state->theme) Py_RETURN_NONE;
+    Py_INCREF(state->theme);
+    return state->theme;
+}
+
+/****************************************************************
+ *  Fonts                                                       *
+ ****************************************************************/
+
+/* lvgl.Font(source=None, *, glyph_cb=None, height=0, bpp=4, cache_size=32768, fallback=None)
+ *
+ * A font_t whose glyphs are rendered when lvgl first draws them. The glyphs
+ * come from source, a font in the binary format of lv_font_conv (bytes-like,
+ * or the path of the file), or from glyph_cb(letter), which returns None if
+ * the letter is not in the font or (width, alpha) with alpha a bytes-like of
+ * width * height 8-bit coverage values, row by row. height is the line
+ * height and bpp the bits per pixel of a glyph_cb font; a font file has its
+ * own. The font_t fields are read-only.
+ *
+ * Rendered glyphs are kept in a cache of at most cache_size bytes, from which
+ * the least recently used glyphs are evicted. So memory is only paid for the
+ * glyphs which are drawn, rather than for a complete built-in font. Letters
+ * which are not in the font are drawn from fallback (a font_t, e.g.
+ * lvgl.font_symbol_20), lvgl's next_page.
+ *
+ * Font.cache_info(reset=False) returns the cache statistics and
+ * Font.set_cache_size(nbytes) changes the size of the cache.
+ */
+#define FONT_CACHE_BUCKETS 256
+
+typedef struct font_glyph_t {
+    struct font_glyph_t *hash_next;     // next glyph in the same hash bucket
+    struct font_glyph_t *prev, *next;   // LRU list, most recently used first
+    size_t size;
+    uint32_t letter;
+    int16_t width;                      // -1: the letter is not in the font
+    uint8_t bitmap[];                   // h_px rows of (width * bpp + 7) / 8 bytes
+} font_glyph_t;
+
+// The tables of an lv_font_conv binary font. Each table starts with its
+// length (which includes the 8 byte header) and a 4 character tag
+typedef struct {
+    const uint8_t *cmap, *loca, *glyf;
+    uint32_t cmap_len, loca_len, glyf_len;
+    uint32_t subtables, glyphs;
+    int16_t ascent, descent;
+    uint16_t default_adv_w;
+    uint8_t loca_32, adv_w_int, bpp, xy_bits, wh_bits, adv_w_bits, compression;
+} font_file_t;
+
+typedef struct {
+    StructObject base;                  // base.data points to font
+    lv_font_t font;
+    PyObject *source;                   // bytes of the font file, or NULL
+    font_file_t file;
+    PyObject *glyph_cb;
+    PyObject *fallback;
+    PyInterpreterState *interp;
+    font_glyph_t *buckets[FONT_CACHE_BUCKETS];
+    font_glyph_t *head, *tail;
+    size_t cache_size, cache_used;
+    uint32_t glyphs;
+    unsigned long long hits, misses, evictions;
+} pylv_Font;
+
+static PyTypeObject pylv_Font_Type;
+
+#define FONT_FROM_LV(font) ((pylv_Font *) ((char *) (font) - offsetof(pylv_Font, font)))
+
+static uint16_t font_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t font_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Read the tables of a font file. Returns 0 on success, -1 with ValueError
+ * set if the data is not a supported font
+ */
+static int font_file_parse(font_file_t *f, const uint8_t *data, size_t size) {
+    const uint8_t *head = NULL;
+    size_t pos = 0;
+    uint32_t len;
+    
+    memset(f, 0, sizeof(*f));
+    while (pos + 8 <= size) {
+        len = font_u32(data + pos);
+        if ((len < 8) || (len > size - pos)) break;
+        if (!memcmp(data + pos + 4, "head", 4) && (len >= 44)) {
+            head = data + pos;
+        } else if (!memcmp(data + pos + 4, "cmap", 4) && (len >= 12)) {
+            f->cmap = data + pos;
+            f->cmap_len = len;
+        } else if (!memcmp(data + pos + 4, "loca", 4) && (len >= 12)) {
+            f->loca = data + pos;
+            f->loca_len = len;
+        } else if (!memcmp(data + pos + 4, "glyf", 4)) {
+            f->glyf = data + pos;
+            f->glyf_len = len;
+        }
+        pos += len;
+    }
+    if (!head || !f->cmap || !f->loca || !f->glyf) {
+        PyErr_SetString(PyExc_ValueError, "not an lvgl binary font (head, cmap, loca or glyf table missing)");
+        return -1;
+    }
+    
+    f->ascent = (int16_t) font_u16(head + 16);
+    f->descent = (int16_t) font_u16(head + 18);
+    f->default_adv_w = font_u16(head + 30);
+    f->loca_32 = head[34];
+    f->adv_w_int = (head[36] == 0);
+    f->bpp = head[37];
+    f->xy_bits = head[38];
+    f->wh_bits = head[39];
+    f->adv_w_bits = head[40];
+    f->compression = head[41];
+    f->subtables = font_u32(f->cmap + 8);
+    f->glyphs = font_u32(f->loca + 8);
+    
+    if ((f->bpp != 1) && (f->bpp != 2) && (f->bpp != 3) && (f->bpp != 4) && (f->bpp != 8)) {
+        PyErr_Format(PyExc_ValueError, "unsupported font bpp %d", f->bpp);
+        return -1;
+    }
+    if (f->compression > 2) {
+        PyErr_Format(PyExc_ValueError, "unsupported font compression %d", f->compression);
+        return -1;
+    }
+    if ((f->xy_bits > 16) || (f->wh_bits > 16) || (f->adv_w_bits > 32) || (f->ascent - f->descent <= 0) || (f->ascent - f->descent > 255)) {
+        PyErr_SetString(PyExc_ValueError, "invalid font header");
+        return -1;
+    }
+    if ((f->subtables > (f->cmap_len - 12) / 16) || (f->glyphs > (f->loca_len - 12) / (f->loca_32 ? 4 : 2))) {
+        PyErr_SetString(PyExc_ValueError, "font table truncated");
+        return -1;
+    }
+    return 0;
+}
+
+/* The glyph id of letter, 0 if it is not in the font */
+static uint32_t font_file_glyph_id(const font_file_t *f, uint32_t letter) {
+    const uint8_t *sub, *list;
+    uint32_t offset, start, rcp, lo, hi, mid;
+    uint16_t length, id_start, entries;
+    
+    for (uint32_t i = 0; i < f->subtables; i++) {
+        sub = f->cmap + 12 + 16 * i;
+        offset = font_u32(sub);
+        start = font_u32(sub + 4);
+        length = font_u16(sub + 8);
+        id_start = font_u16(sub + 10);
+        entries = font_u16(sub + 12);
+        if ((letter < start) || (letter - start >= length)) continue;
+        rcp = letter - start;
+        list = f->cmap + offset;
+        
+        switch (sub[14]) {
+            case 0: // full: a uint8 glyph id offset per letter
+                if ((offset > f->cmap_len) || (rcp >= f->cmap_len - offset)) return 0;
+                return id_start + list[rcp];
+            case 2: // tiny: consecutive glyph ids
+                return id_start + rcp;
+            case 1: // sparse full: a sorted uint16 list of letters, then a uint16 glyph id offset per letter
+            case 3: // sparse tiny: a sorted uint16 list of letters with consecutive glyph ids
+                if ((offset > f->cmap_len) || ((uint32_t) entries * (sub[14] == 1 ? 4 : 2) > f->cmap_len - offset)) return 0;
+                lo = 0;
+                hi = entries;
+                while (lo < hi) {
+                    mid = (lo + hi) / 2;
+                    if (font_u16(list + 2 * mid) < rcp) lo = mid + 1;
+                    else hi = mid;
+                }
+                if ((lo == entries) || (font_u16(list + 2 * lo) != rcp)) return 0;
+                return id_start + ((sub[14] == 1) ? font_u16(list + 2 * entries + 2 * lo) : lo);
+        }
+    }
+    return 0;
+}
+
+// The glyph data is a bit stream, most significant bit first
+typedef struct {
+    const uint8_t *data;
+    size_t nbits;
+    size_t pos;
+} font_bits_t;
+
+static uint32_t font_bits_read(font_bits_t *bits, int n) {
+    uint32_t v = 0;
+    
+    while (n--) {
+        v <<= 1;
+        if (bits->pos < bits->nbits) v |= (bits->data[bits->pos >> 3] >> (7 - (bits->pos & 7))) & 1;
+        bits->pos++;
+    }
+    return v;
+}
+
+static int32_t font_bits_read_signed(font_bits_t *bits, int n) {
+    uint32_t v = font_bits_read(bits, n);
+    
+    if (n && (v & (1u << (n - 1)))) return (int32_t) v - (int32_t) (1u << n);
+    return v;
+}
+
+/* Run-length decoder for compressed glyphs, as lv_font_fmt_txt.c of lvgl 7:
+ * a value is repeated after it occurred twice, for as long as 1 bits follow;
+ * after 10 of those, a 6-bit repeat count follows
+ */
+typedef struct {
+    font_bits_t bits;
+    int bpp;
+    enum {FONT_RLE_SINGLE, FONT_RLE_REPEAT, FONT_RLE_COUNTER} state;
+    uint8_t prev;
+    uint32_t count;
+    bool first;
+} font_rle_t;
+
+static uint8_t font_rle_next(font_rle_t *rle) {
+    uint8_t ret = rle->prev;
+    
+    if (rle->state == FONT_RLE_SINGLE) {
+        ret = font_bits_read(&rle->bits, rle->bpp);
+        if (!rle->first && (ret == rle->prev)) {
+            rle->count = 0;
+            rle->state = FONT_RLE_REPEAT;
+        }
+        rle->first = false;
+        rle->prev = ret;
+    } else if (rle->state == FONT_RLE_REPEAT) {
+        rle->count++;
+        if (font_bits_read(&rle->bits, 1)) {
+            if (rle->count == 11) {
+                rle->count = font_bits_read(&rle->bits, 6);
+                if (rle->count) {
+                    rle->state = FONT_RLE_COUNTER;
+                } else {
+                    ret = rle->prev = font_bits_read(&rle->bits, rle->bpp);
+                    rle->state = FONT_RLE_SINGLE;
+                }
+            }
+        } else {
+            ret = rle->prev = font_bits_read(&rle->bits, rle->bpp);
+            rle->state = FONT_RLE_SINGLE;
+        }
+    } else {
+        if (--rle->count == 0) {
+            ret = rle->prev = font_bits_read(&rle->bits, rle->bpp);
+            rle->state = FONT_RLE_SINGLE;
+        }
+    }
+    return ret;
+}
+
+/* Allocate a glyph of width pixels with an empty bitmap; width -1 for a
+ * letter which is not in the font
+ */
+static font_glyph_t *font_glyph_new(pylv_Font *self, uint32_t letter, int width) {
+    size_t bitmap_size = (width > 0) ? (size_t) self->font.h_px * ((width * self->font.bpp + 7) / 8) : 0;
+    font_glyph_t *glyph = PyMem_RawCalloc(1, sizeof(font_glyph_t) + bitmap_size);
+    
+    if (!glyph) return NULL;
+    glyph->size = sizeof(font_glyph_t) + bitmap_size;
+    glyph->letter = letter;
+    glyph->width = width;
+    return glyph;
+}
+
+/* Set pixel x, y of glyph to value v of src_bpp bits */
+static void font_glyph_put(pylv_Font *self, font_glyph_t *glyph, int x, int y, uint32_t v, int src_bpp) {
+    int bpp = self->font.bpp;
+    size_t bit;
+    
+    if ((x < 0) || (x >= glyph->width) || (y < 0) || (y >= self->font.h_px) || !v) return;
+    if (src_bpp != bpp) {
+        v = v * 255 / ((1u << src_bpp) - 1);
+        v = (v * ((1u << bpp) - 1) + 127) / 255;
+    }
+    bit = (size_t) y * ((glyph->width * bpp + 7) / 8) * 8 + (size_t) x * bpp;
+    glyph->bitmap[bit >> 3] |= v << (8 - bpp - (bit & 7));
+}
+
+static font_glyph_t *font_render_file(pylv_Font *self, uint32_t letter) {
+    font_file_t *f = &self->file;
+    font_glyph_t *glyph;
+    font_bits_t bits;
+    font_rle_t rle;
+    uint32_t id, offset, end, adv_w, v;
+    int32_t ofs_x, ofs_y, box_w, box_h, width, y0;
+    uint8_t *line;
+    
+    id = font_file_glyph_id(f, letter);
+    if (!id || (id >= f->glyphs)) return font_glyph_new(self, letter, -1);
+    
+    if (f->loca_32) {
+        offset = font_u32(f->loca + 12 + 4 * id);
+        end = (id + 1 < f->glyphs) ? font_u32(f->loca + 12 + 4 * (id + 1)) : f->glyf_len;
+    } else {
+        offset = font_u16(f->loca + 12 + 2 * id);
+        end = (id + 1 < f->glyphs) ? font_u16(f->loca + 12 + 2 * (id + 1)) : f->glyf_len;
+    }
+    if ((offset < 8) || (end > f->glyf_len) || (end < offset)) return font_glyph_new(self, letter, -1);
+    
+    bits.data = f->glyf + offset;
+    bits.nbits = (size_t) (end - offset) * 8;
+    bits.pos = 0;
+    adv_w = f->adv_w_bits ? font_bits_read(&bits, f->adv_w_bits) : f->default_adv_w;
+    if (f->adv_w_int) adv_w <<= 4;  // else: 4 bits fraction
+    ofs_x = font_bits_read_signed(&bits, f->xy_bits);
+    ofs_y = font_bits_read_signed(&bits, f->xy_bits);
+    box_w = font_bits_read(&bits, f->wh_bits);
+    box_h = font_bits_read(&bits, f->wh_bits);
+    
+    width = (adv_w + 8) >> 4;
+    if (ofs_x + box_w > width) width = ofs_x + box_w;
+    if (width > 255) width = 255;
+    glyph = font_glyph_new(self, letter, width);
+    if (!glyph || !box_w || !box_h) return glyph;
+    
+    // Rows are counted from the top of the line; ofs_y is the distance of
+    // the bottom of the box to the baseline
+    y0 = f->ascent - box_h - ofs_y;
+    if (f->compression == 0) {
+        for (int32_t y = 0; y < box_h; y++) {
+            for (int32_t x = 0; x < box_w; x++) {
+                font_glyph_put(self, glyph, ofs_x + x, y0 + y, font_bits_read(&bits, f->bpp), f->bpp);
+            }
+        }
+        return glyph;
+    }
+    
+    line = PyMem_RawCalloc(box_w, 1);
+    if (!line) {
+        PyMem_RawFree(glyph);
+        return NULL;
+    }
+    rle.bits = bits;
+    rle.bpp = f->bpp;
+    rle.state = FONT_RLE_SINGLE;
+    rle.prev = 0;
+    rle.count = 0;
+    rle.first = true;
+    for (int32_t y = 0; y < box_h; y++) {
+        for (int32_t x = 0; x < box_w; x++) {
+            v = font_rle_next(&rle);
+            // compression 1 stores each line XOR the line above
+            line[x] = ((f->compression == 1) && y) ? (line[x] ^ v) : v;
+            font_glyph_put(self, glyph, ofs_x + x, y0 + y, line[x], f->bpp);
+        }
+    }
+    PyMem_RawFree(line);
+    return glyph;
+}
+
+static font_glyph_t *font_render_cb(pylv_Font *self, uint32_t letter) {
+    font_glyph_t *glyph = NULL;
+    PyObject *result;
+    Py_buffer alpha;
+    int width;
+    
+    PyThreadState *prev = interp_enter(self->interp);
+    result = PyObject_CallFunction(self->glyph_cb, "k", (unsigned long) letter);
+    if (result == Py_None) {
+        glyph = font_glyph_new(self, letter, -1);
+    } else if (result) {
+        if (PyArg_ParseTuple(result, "iy*;glyph_cb must return None or (width, alpha)", &width, &alpha)) {
+            if ((width < 0) || (width > 255)) {
+                PyErr_Format(PyExc_ValueError, "glyph width %d out of range 0..255", width);
+            } else if (alpha.len != (Py_ssize_t) width * self->font.h_px) {
+                PyErr_Format(PyExc_ValueError, "glyph alpha should be %d bytes, not %zd", width * self->font.h_px, alpha.len);
+            } else if ((glyph = font_glyph_new(self, letter, width))) {
+                for (int y = 0; y < self->font.h_px; y++) {
+                    for (int x = 0; x < width; x++) {
+                        font_glyph_put(self, glyph, x, y, ((uint8_t *) alpha.buf)[y * width + x], 8);
+                    }
+                }
+            }
+            PyBuffer_Release(&alpha);
+        }
+        Py_DECREF(result);
+    }
+    if (PyErr_Occurred()) {
+        // The letter is cached as missing, so the error is printed only once
+        PyErr_Print();
+        PyErr_Clear();
+        if (!glyph) glyph = font_glyph_new(self, letter, -1);
+    }
+    interp_leave(prev);
+    return glyph;
+}
+
+static void font_cache_unlink(pylv_Font *self, font_glyph_t *glyph) {
+    if (glyph->prev) glyph->prev->next = glyph->next;
+    else self->head = glyph->next;
+    if (glyph->next) glyph->next->prev = glyph->prev;
+    else self->tail = glyph->prev;
+}
+
+static void font_cache_link(pylv_Font *self, font_glyph_t *glyph) {
+    glyph->prev = NULL;
+    glyph->next = self->head;
+    if (self->head) self->head->prev = glyph;
+    else self->tail = glyph;
+    self->head = glyph;
+}
+
+static void font_cache_remove(pylv_Font *self, font_glyph_t *glyph) {
+    font_glyph_t **p = &self->buckets[glyph->letter % FONT_CACHE_BUCKETS];
+    
+    while (*p != glyph) p = &(*p)->hash_next;
+    *p = glyph->hash_next;
+    font_cache_unlink(self, glyph);
+    self->cache_used -= glyph->size;
+    self->glyphs--;
+    PyMem_RawFree(glyph);
+}
+
+/* Evict the least recently used glyphs until the cache fits its size. The
+ * most recently used glyph is kept: lvgl draws from the bitmap returned by
+ * the last get_bitmap call
+ */
+static void font_cache_trim(pylv_Font *self) {
+    while ((self->cache_used > self->cache_size) && (self->tail != self->head)) {
+        font_cache_remove(self, self->tail);
+        self->evictions++;
+    }
+}
+
+/* Return the glyph of letter, rendering it on a cache miss. Returns NULL on
+ * out of memory. Must be called with the lvgl lock held
+ */
+static font_glyph_t *font_glyph(pylv_Font *self, uint32_t letter) {
+    font_glyph_t **bucket = &self->buckets[letter % FONT_CACHE_BUCKETS];
+    font_glyph_t *glyph;
+    
+    for (glyph = *bucket; glyph; glyph = glyph->hash_next) {
+        if (glyph->letter == letter) {
+            self->hits++;
+            if (glyph != self->head) {
+                font_cache_unlink(self, glyph);
+                font_cache_link(self, glyph);
+            }
+            return glyph;
+        }
+    }
+    
+    self->misses++;
+    glyph = self->source ? font_render_file(self, letter) : font_render_cb(self, letter);
+    if (!glyph) return NULL;
+    glyph->hash_next = *bucket;
+    *bucket = glyph;
+    font_cache_link(self, glyph);
+    self->cache_used += glyph->size;
+    self->glyphs++;
+    font_cache_trim(self);
+    return glyph;
+}
+
+static const uint8_t *font_get_bitmap(const lv_font_t *font, uint32_t letter) {
+    font_glyph_t *glyph = font_glyph(FONT_FROM_LV(font), letter);
+    
+    return (glyph && (glyph->width >= 0)) ? glyph->bitmap : NULL;
+}
+
+static int16_t font_get_width(const lv_font_t *font, uint32_t letter) {
+    font_glyph_t *glyph = font_glyph(FONT_FROM_LV(font), letter);
+    
+    return glyph ? glyph->width : -1;
+}
+
+/* Read the font file at path with Python's io, returns a bytes object */
+static PyObject *font_read_path(PyObject *path) {
+    PyObject *io, *file, *data, *ret;
+    
+    io = PyImport_ImportModule("io");
+    if (!io) return NULL;
+    file = PyObject_CallMethod(io, "open", "Os", path, "rb");
+    Py_DECREF(io);
+    if (!file) return NULL;
+    data = PyObject_CallMethod(file, "read", NULL);
+    ret = PyObject_CallMethod(file, "close", NULL);
+    Py_DECREF(file);
+    if (!ret) {
+        Py_XDECREF(data);
+        return NULL;
+    }
+    Py_DECREF(ret);
+    if (data && !PyBytes_Check(data)) {
+        PyErr_SetString(PyExc_TypeError, "font file read() did not return bytes");
+        Py_CLEAR(data);
+    }
+    return data;
+}
+
+static int
+Font_init(pylv_Font *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"source", "glyph_cb", "height", "bpp", "cache_size", "fallback", NULL};
+    PyObject *source = Py_None, *glyph_cb = Py_None, *fallback = Py_None;
+    int height = 0, bpp = 4;
+    Py_ssize_t cache_size = 32768;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O$OiinO", kwlist, &source, &glyph_cb, &height, &bpp, &cache_size, &fallback)) {
+        return -1;
+    }
+    if (self->base.data) {
+        PyErr_SetString(PyExc_RuntimeError, "Font is already initialized");
+        return -1;
+    }
+    if ((source == Py_None) == (glyph_cb == Py_None)) {
+        PyErr_SetString(PyExc_TypeError, "either source or glyph_cb is required");
+        return -1;
+    }
+    if ((glyph_cb != Py_None) && !PyCallable_Check(glyph_cb)) {
+        PyErr_SetString(PyExc_TypeError, "glyph_cb must be callable");
+        return -1;
+    }
+    if ((fallback != Py_None) && !PyObject_TypeCheck(fallback, &pylv_font_t_Type)) {
+        PyErr_Format(PyExc_TypeError, "fallback must be a font_t or None, not %.200s", Py_TYPE(fallback)->tp_name);
+        return -1;
+    }
+    if (cache_size < 0) {
+        PyErr_SetString(PyExc_ValueError, "cache_size must be non-negative");
+        return -1;
+    }
+    
+    if (source != Py_None) {
+        if (PyUnicode_Check(source) || PyObject_HasAttrString(source, "__fspath__")) {
+            self->source = font_read_path(source);
+        } else {
+            self->source = PyBytes_FromObject(source);
+        }
+        if (!self->source) return -1;
+        if (font_file_parse(&self->file, (const uint8_t *) PyBytes_AS_STRING(self->source), PyBytes_GET_SIZE(self->source))) {
+            Py_CLEAR(self->source);
+            return -1;
+        }
+        height = self->file.ascent - self->file.descent;
+        bpp = (self->file.bpp == 3) ? 4 : self->file.bpp;
+    } else {
+        if ((height < 1) || (height > 255)) {
+            PyErr_SetString(PyExc_ValueError, "height must be in the range 1..255");
+            return -1;
+        }
+        if ((bpp != 1) && (bpp != 2) && (bpp != 4) && (bpp != 8)) {
+            PyErr_SetString(PyExc_ValueError, "bpp must be 1, 2, 4 or 8");
+            return -1;
+        }
+        Py_INCREF(glyph_cb);
+        self->glyph_cb = glyph_cb;
+    }
+    if (fallback != Py_None) {
+        Py_INCREF(fallback);
+        self->fallback = fallback;
+    }
+    
+    self->interp = PyInterpreterState_Get();
+    self->cache_size = cache_size;
+    self->font.unicode_first = 0;
+    self->font.unicode_last = 0x10FFFF;
+    self->font.get_bitmap = font_get_bitmap;
+    self->font.get_width = font_get_width;
+    self->font.next_page = (fallback != Py_None) ? (lv_font_t *) ((StructObject *) fallback)->data : NULL;
+    self->font.h_px = height;
+    self->font.bpp = bpp;
+    self->base.data = (char *) &self->font;
+    self->base.size = sizeof(lv_font_t);
+    self->base.owner = NULL;
+    self->base.readonly = 1;
+    
+    // Like the built-in fonts, a Font is never freed while styles may refer to it
+    return Struct_register(&self->base);
+}
+
+static void
+Font_dealloc(pylv_Font *self) {
+    while (self->head) font_cache_remove(self, self->head);
+    Py_XDECREF(self->source);
+    Py_XDECREF(self->glyph_cb);
+    Py_XDECREF(self->fallback);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+Font_cache_info(pylv_Font *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    ret = Py_BuildValue("{snsnsIsKsKsK}",
+        "size", (Py_ssize_t) self->cache_size,
+        "used", (Py_ssize_t) self->cache_used,
+        "glyphs", self->glyphs,
+        "hits", self->hits,
+        "misses", self->misses,
+        "evictions", self->evictions);
+    if (ret && reset) self->hits = self->misses = self->evictions = 0;
+    LVGL_UNLOCK
+    
+    return ret;
+}
+
+static PyObject *
+Font_set_cache_size(pylv_Font *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"nbytes", NULL};
+    Py_ssize_t nbytes;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &nbytes)) {
+        return NULL;
+    }
+    if (nbytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "nbytes must be non-negative");
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    self->cache_size = nbytes;
+    font_cache_trim(self);
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Font_get_fallback(pylv_Font *self, void *closure) {
+    if (!self->fallback) Py_RETURN_NONE;
+    Py_INCREF(self->fallback);
+    return self->fallback;
+}
+
+static PyMethodDef Font_methods[] = {
+    {"cache_info", (PyCFunction) Font_cache_info, METH_VARARGS | METH_KEYWORDS, "glyph cache statistics; reset=True clears the counters"},
+    {"set_cache_size", (PyCFunction) Font_set_cache_size, METH_VARARGS | METH_KEYWORDS, "set the size of the glyph cache in bytes"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef Font_getset[] = {
+    {"fallback", (getter) Font_get_fallback, NULL, "font_t for letters which are not in this font", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_Font_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.Font",
+    .tp_basicsize = sizeof(pylv_Font),
+    .tp_base = &pylv_font_t_Type,
+    .tp_dealloc = (destructor) Font_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "lvgl font rendered at run time from a font file or a Python function",
+    .tp_methods = Font_methods,
+    .tp_getset = Font_getset,
+    .tp_init = (initproc) Font_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/****************************************************************
+ *  Screen pool                                                 *
+ ****************************************************************/
+
+/* lvgl.ScreenPool(build, capacity=4)
+ *
+ * Keeps up to capacity screens, built by build(key), alive, so switching to a
+ * screen which was shown before only loads it (which hides the current one)
+ * instead of deleting one screen and building another. Screens which do not
+ * fit are deleted with obj_delete_tree, least recently shown first; the
+ * loaded screen is never deleted.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *build;
+    PyObject *screens; // dict of key: screen, least recently used first
+    Py_ssize_t capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    uint64_t build_ns;
+    teardown_stats_t teardown;
+} pylv_ScreenPool;
+
+static PyTypeObject pylv_ScreenPool_Type;
+
+static bool pool_screen_loaded(pylv_Obj *screen) {
+    bool loaded;
+    
+    if (!screen->ref) return false;
+    LVGL_LOCK
+    loaded = obj_is_loaded(screen->ref);
+    LVGL_UNLOCK
+    return loaded;
+}
+
+/* Delete a screen which was removed from the pool; steals the reference */
+static void pool_delete(pylv_ScreenPool *self, pylv_Obj *screen) {
+    if (screen->ref) obj_delete_tree(screen->ref, &self->teardown);
+    Py_DECREF(screen);
+}
+
+/* Evict screens until the pool fits its capacity. The loaded screen and keep
+ * are not evicted
+ */
+static int pool_trim(pylv_ScreenPool *self, PyObject *keep) {
+    Py_ssize_t pos;
+    PyObject *key, *screen;
+    bool found;
+    
+    while (PyDict_GET_SIZE(self->screens) > self->capacity) {
+        pos = 0;
+        found = false;
+        while (!found && PyDict_Next(self->screens, &pos, &key, &screen)) {
+            found = (screen != keep) && !pool_screen_loaded((pylv_Obj *) screen);
+        }
+        if (!found) break;
+        
+        Py_INCREF(key);
+        Py_INCREF(screen);
+        if (PyDict_DelItem(self->screens, key)) {
+            Py_DECREF(key);
+            Py_DECREF(screen);
+            return -1;
+        }
+        Py_DECREF(key);
+        self->evictions++;
+        pool_delete(self, (pylv_Obj *) screen);
+    }
+    return 0;
+}
+
+/* Returns a new reference to the screen for key, building it if it is not in
+ * the pool, and marks it as most recently used
+ */
+static pylv_Obj *pool_get(pylv_ScreenPool *self, PyObject *key) {
+    PyObject *screen;
+    lv_obj_t *parent;
+    int64_t t0;
+    
+    screen = PyDict_GetItemWithError(self->screens, key); // borrowed reference
+    if (!screen && PyErr_Occurred()) return NULL;
+    if (screen && ((pylv_Obj *) screen)->ref) {
+        self->hits++;
+        Py_INCREF(screen);
+        // move it to the end
+        if (PyDict_DelItem(self->screens, key) || PyDict_SetItem(self->screens, key, screen)) {
+            Py_DECREF(screen);
+            return NULL;
+        }
+        return (pylv_Obj *) screen;
+    }
+    
+    // not in the pool, or it has been deleted
+    self->misses++;
+    t0 = monotonic_ns();
+    screen = PyObject_CallFunctionObjArgs(self->build, key, NULL);
+    self->build_ns += monotonic_ns() - t0;
+    if (!screen) return NULL;
+    if (!PyObject_TypeCheck(screen, &pylv_obj_Type)) {
+        PyErr_Format(PyExc_TypeError, "build must return an Obj, not %.200s", Py_TYPE(screen)->tp_name);
+        Py_DECREF(screen);
+        return NULL;
+    }
+    if (check_alive((pylv_Obj *) screen)) {
+        Py_DECREF(screen);
+        return NULL;
+    }
+    LVGL_LOCK
+    parent = lv_obj_get_parent(((pylv_Obj *) screen)->ref);
+    LVGL_UNLOCK
+    if (parent) {
+        PyErr_SetString(PyExc_ValueError, "build must return a screen (an Obj without parent)");
+        Py_DECREF(screen);
+        return NULL;
+    }
+    
+    if (PyDict_SetItem(self->screens, key, screen) || pool_trim(self, screen)) {
+        Py_DECREF(screen);
+        return NULL;
+    }
+    return (pylv_Obj *) screen;
+}
+
+static int
+ScreenPool_init(pylv_ScreenPool *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"build", "capacity", NULL};
+    PyObject *build;
+    Py_ssize_t capacity = 4;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n", kwlist, &build, &capacity)) {
+        return -1;
+    }
+    if (self->screens) {
+        PyErr_SetString(PyExc_RuntimeError, "ScreenPool is already initialized");
+        return -1;
+    }
+    if (!PyCallable_Check(build)) {
+        PyErr_SetString(PyExc_TypeError, "build must be callable");
+        return -1;
+    }
+    if (capacity < 1) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be at least 1");
+        return -1;
+    }
+    
+    self->screens = PyDict_New();
+    if (!self->screens) return -1;
+    Py_INCREF(build);
+    self->build = build;
+    self->capacity = capacity;
+    return 0;
+}
+
+static int
+check_pool(pylv_ScreenPool *self) {
+    if (!self->screens) {
+        PyErr_SetString(PyExc_RuntimeError, "ScreenPool is not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+static int
+ScreenPool_traverse(pylv_ScreenPool *self, visitproc visit, void *arg) {
+    Py_VISIT(self->build);
+    Py_VISIT(self->screens);
+    return 0;
+}
+
+static int
+ScreenPool_clear(pylv_ScreenPool *self) {
+    // The screens are deleted (when they are owned by Python and no longer
+    // referenced) by Obj_finalize
+    Py_CLEAR(self->build);
+    Py_CLEAR(self->screens);
+    return 0;
+}
+
+static void
+ScreenPool_dealloc(pylv_ScreenPool *self) {
+    PyObject_GC_UnTrack(self);
+    ScreenPool_clear(self);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+ScreenPool_get(pylv_ScreenPool *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"key", NULL};
+    PyObject *key;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &key)) {
+        return NULL;
+    }
+    if (check_pool(self)) return NULL;
+    
+    return (PyObject *) pool_get(self, key);
+}
+
+static PyObject *
+ScreenPool_show(pylv_ScreenPool *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"key", NULL};
+    PyObject *key;
+    pylv_Obj *screen;
+    lvgl_state *state;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &key)) {
+        return NULL;
+    }
+    if (check_pool(self)) return NULL;
+    state = get_state();
+    if (!state) return NULL;
+    
+    screen = pool_get(self, key);
+    if (!screen) return NULL;
+    scr_load(state, screen);
+    
+    // the previously shown screen may be evicted now
+    if (pool_trim(self, (PyObject *) screen)) {
+        Py_DECREF(screen);
+        return NULL;
+    }
+    return (PyObject *) screen;
+}
+
+static PyObject *
+ScreenPool_discard(pylv_ScreenPool *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"key", NULL};
+    PyObject *key = Py_None, *keys, *screen;
+    Py_ssize_t i, n = 0;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &key)) {
+        return NULL;
+    }
+    if (check_pool(self)) return NULL;
+    
+    if (key != Py_None) {
+        screen = PyDict_GetItemWithError(self->screens, key); // borrowed reference
+        if (!screen) {
+            if (!PyErr_Occurred()) PyErr_SetObject(PyExc_KeyError, key);
+            return NULL;
+        }
+        if (pool_screen_loaded((pylv_Obj *) screen)) {
+            PyErr_SetString(PyExc_RuntimeError, "cannot discard the shown screen");
+            return NULL;
+        }
+        keys = PyList_New(1);
+        if (!keys) return NULL;
+        Py_INCREF(key);
+        PyList_SET_ITEM(keys, 0, key);
+    } else {
+        keys = PyDict_Keys(self->screens);
+        if (!keys) return NULL;
+    }
+    
+    for (i = 0; i < PyList_GET_SIZE(keys); i++) {
+        key = PyList_GET_ITEM(keys, i);
+        screen = PyDict_GetItemWithError(self->screens, key); // borrowed reference
+        if (!screen) {
+            if (PyErr_Occurred()) goto error;
+            continue;
+        }
+        if (pool_screen_loaded((pylv_Obj *) screen)) continue;
+        Py_INCREF(screen);
+        if (PyDict_DelItem(self->screens, key)) {
+            Py_DECREF(screen);
+            goto error;
+        }
+        pool_delete(self, (pylv_Obj *) screen);
+        n++;
+    }
+    Py_DECREF(keys);
+    return PyLong_FromSsize_t(n);
+
+error:
+    Py_DECREF(keys);
+    return NULL;
+}
+
+static PyObject *
+ScreenPool_info(pylv_ScreenPool *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    if (check_pool(self)) return NULL;
+    
+    ret = Py_BuildValue("{snsnsKsKsKsKsN}",
+        "screens", PyDict_GET_SIZE(self->screens),
+        "capacity", self->capacity,
+        "hits", self->hits,
+        "misses", self->misses,
+        "evictions", self->evictions,
+        "build_ns", (unsigned long long) self->build_ns,
+        "teardown", teardown_stats_dict(&self->teardown));
+    if (ret && reset) {
+        self->hits = self->misses = self->evictions = self->build_ns = 0;
+        memset(&self->teardown, 0, sizeof(self->teardown));
+    }
+    return ret;
+}
+
+static PyObject *
+ScreenPool_get_capacity(pylv_ScreenPool *self, void *closure) {
+    return PyLong_FromSsize_t(self->capacity);
+}
+
+static int
+ScreenPool_set_capacity(pylv_ScreenPool *self, PyObject *value, void *closure) {
+    Py_ssize_t capacity;
+    
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError, "cannot delete capacity");
+        return -1;
+    }
+    if (check_pool(self)) return -1;
+    capacity = PyLong_AsSsize_t(value);
+    if ((capacity == -1) && PyErr_Occurred()) return -1;
+    if (capacity < 1) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be at least 1");
+        return -1;
+    }
+    self->capacity = capacity;
+    return pool_trim(self, NULL);
+}
+
+static PyMethodDef ScreenPool_methods[] = {
+    {"show", (PyCFunction) ScreenPool_show, METH_VARARGS | METH_KEYWORDS, "load the screen for key, building it if it is not in the pool; returns the screen"},
+    {"get", (PyCFunction) ScreenPool_get, METH_VARARGS | METH_KEYWORDS, "the screen for key, building it if it is not in the pool, without loading it"},
+    {"discard", (PyCFunction) ScreenPool_discard, METH_VARARGS | METH_KEYWORDS, "delete the screen for key (or all screens except the shown one); returns the number of screens deleted"},
+    {"info", (PyCFunction) ScreenPool_info, METH_VARARGS | METH_KEYWORDS, "pool and teardown statistics; reset=True clears the counters"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef ScreenPool_getset[] = {
+    {"capacity", (getter) ScreenPool_get_capacity, (setter) ScreenPool_set_capacity, "maximum number of screens kept", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyTypeObject pylv_ScreenPool_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "lvgl.ScreenPool",
+    .tp_basicsize = sizeof(pylv_ScreenPool),
+    .tp_dealloc = (destructor) ScreenPool_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_doc = "pool of pre-built screens, switched by loading them instead of rebuilding",
+    .tp_traverse = (traverseproc) ScreenPool_traverse,
+    .tp_clear = (inquiry) ScreenPool_clear,
+    .tp_methods = ScreenPool_methods,
+    .tp_getset = ScreenPool_getset,
+    .tp_init = (initproc) ScreenPool_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* C API, see lvgl_capi.h */
+static lvgl_capi_t lvgl_capi = {
+    .version = LVGL_CAPI_VERSION,
+    .input_push = input_dev_push,
+};
+
+/* The module functions use a default InputDevice per type, created on first
+ * use
+ */
+static input_dev_t *get_input_dev(lvgl_state *state, long type) {
+    if ((type <= LV_INDEV_TYPE_NONE) || (type > LV_INDEV_TYPE_ENCODER)) {
+        PyErr_Format(PyExc_ValueError, "invalid input device type %ld", type);
+        return NULL;
+    }
+    
+    if (!state->input[type]) {
+        state->input[type] = PyObject_CallFunction((PyObject *) &InputDevice_Type, "l", type);
+        if (!state->input[type]) return NULL;
+    }
+    return &((InputDeviceObject *) state->input[type])->dev;
+}
+
+static PyObject *
+pylv_push_input_events(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"type", "events", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    long type;
+    PyObject *events;
+    input_dev_t *dev;
+    Py_ssize_t queued;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "lO", kwlist, &type, &events)) {
+        return NULL;
+    }
+    
+    dev = get_input_dev(state, type);
+    if (!dev) return NULL;
+    
+    queued = push_input_events(dev, events);
+    if (queued < 0) return NULL;
+    return PyLong_FromSsize_t(queued);
+}
+
+static PyObject *
+pylv_push_pointer_events(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"events", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    PyObject *events;
+    input_dev_t *dev;
+    Py_ssize_t queued;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &events)) {
+        return NULL;
+    }
+    
+    dev = get_input_dev(state, LV_INDEV_TYPE_POINTER);
+    if (!dev) return NULL;
+    
+    queued = push_input_events(dev, events);
+    if (queued < 0) return NULL;
+    return PyLong_FromSsize_t(queued);
+}
+
+static PyObject *
+pylv_set_button_points(PyObject *self, PyObject *args, PyObject *kwds) {
+    lvgl_state *state = PyModule_GetState(self);
+    
+    if (!get_input_dev(state, LV_INDEV_TYPE_BUTTON)) return NULL;
+    return InputDevice_set_button_points((InputDeviceObject *) state->input[LV_INDEV_TYPE_BUTTON], args, kwds);
+}
+
+#if LV_USE_GROUP
+static PyObject *
+pylv_set_group(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"group", "type", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    PyObject *group;
+    long type = LV_INDEV_TYPE_KEYPAD;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|l", kwlist, &group, &type)) {
+        return NULL;
+    }
+    if (!get_input_dev(state, type)) return NULL;
+    if (input_dev_set_group((InputDeviceObject *) state->input[type], group)) return NULL;
+    
+    Py_RETURN_NONE;
+}
+#endif
+
+static PyObject *
+send_mouse_event(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"x", "y", "pressed", NULL};
+    lvgl_state *state = PyModule_GetState(self);
+    int x=0, y=0, pressed=0;
+    input_dev_t *dev;
+    int32_t event[4];
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "iip", kwlist, &x, &y, &pressed)) {
+        return NULL;
+    }
+    
+    dev = get_input_dev(state, LV_INDEV_TYPE_POINTER);
+    if (!dev) return NULL;
+    
+    event[0] = x;
+    event[1] = y;
+    event[2] = pressed;
+    event[3] = lv_tick_get();
+    input_dev_push(dev, event, 1);
     
     Py_RETURN_NONE;
 }
 
 
-/* TODO: all the framebuffer display driver stuff could be separated (i.e. do not default to it but allow user to register custom frame buffer driver) */
+static PyObject *
+enable_threading(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"stats", NULL};
+    int stats = 0;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &stats)) {
+        return NULL;
+    }
+    
+    if (lock != rlock_acquire) {
+        if (lock) {
+            PyErr_SetString(PyExc_RuntimeError, "a custom lvgl lock has been installed using lv_set_lock_unlock");
+            return NULL;
+        }
+        if (unlocked_sections) {
+            // e.g. called from a callback during lvgl.poll(), or while another thread is in lvgl
+            PyErr_SetString(PyExc_RuntimeError, "enable_threading cannot be called while lvgl is in use");
+            return NULL;
+        }
+        lv_set_lock_unlock(rlock_acquire, NULL, rlock_release, NULL);
+    }
+    lock_stats_enabled = stats;
+    
+    Py_RETURN_NONE;
+}
+
+static int binding_profile_compare(const void *a, const void *b) {
+    const binding_profile_t *pa = *(binding_profile_t * const *) a, *pb = *(binding_profile_t * const *) b;
+    uint64_t ta = pa->parse_ns + pa->lock_ns + pa->call_ns, tb = pb->parse_ns + pb->lock_ns + pb->call_ns;
+    return (ta < tb) - (ta > tb);
+}
+
+/* Return the binding profile as a list of dicts, most expensive (total time)
+ * first
+ */
+static PyObject *
+binding_profile(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    binding_profile_t *profile, **profiles = NULL;
+    size_t n = 0, i = 0;
+    PyObject *ret = NULL, *item;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    if (!BINDING_PROFILE) {
+        PyErr_SetString(PyExc_RuntimeError, "lvgl was not generated with profiling (python.py --profile)");
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    for (profile = binding_profiles; profile; profile = profile->next) n++;
+    profiles = PyMem_Malloc(sizeof(binding_profile_t *) * (n + 1));
+    if (!profiles) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (profile = binding_profiles; profile; profile = profile->next) profiles[i++] = profile;
+    qsort(profiles, n, sizeof(binding_profile_t *), binding_profile_compare);
+    
+    ret = PyList_New(n);
+    if (!ret) goto error;
+    for (i = 0; i < n; i++) {
+        profile = profiles[i];
+        item = Py_BuildValue("{sssssKsKsKsKsK}",
+            "name", profile->name,
+            "function", profile->function,
+            "calls", profile->calls,
+            "parse_ns", (unsigned long long) profile->parse_ns,
+            "lock_ns", (unsigned long long) profile->lock_ns,
+            "call_ns", (unsigned long long) profile->call_ns,
+            "total_ns", (unsigned long long) (profile->parse_ns + profile->lock_ns + profile->call_ns));
+        if (!item) {
+            Py_CLEAR(ret);
+            goto error;
+        }
+        PyList_SET_ITEM(ret, i, item);
+    }
+    
+    if (reset) {
+        for (profile = binding_profiles; profile; profile = profile->next) {
+            profile->calls = 0;
+            profile->parse_ns = profile->lock_ns = profile->call_ns = 0;
+        }
+    }
+    
+error:
+    LVGL_UNLOCK
+    PyMem_Free(profiles);
+    return ret;
+}
+
+/* Usage of the lvgl heap, see lv_mem_monitor */
+static PyObject *
+mem_info(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset_peak", NULL};
+    int reset_peak = 0;
+    lv_mem_monitor_t mon;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset_peak)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    mem_sample(&mon);
+    ret = Py_BuildValue("{sIsIsIsIsIsIsIsIsIsksI}",
+        "total_size", (unsigned int) mon.total_size,
+        "free_size", (unsigned int) mon.free_size,
+        "used_size", (unsigned int) (mon.total_size - mon.free_size),
+        "free_biggest_size", (unsigned int) mon.free_biggest_size,
+        "used_pct", (unsigned int) mon.used_pct,
+        "frag_pct", (unsigned int) mon.frag_pct,
+        "free_cnt", (unsigned int) mon.free_cnt,
+        "used_cnt", (unsigned int) mon.used_cnt,
+        "peak_used", (unsigned int) mem_peak_used,
+        "alloc_failures", mem_alloc_failures,
+        "reserve", (unsigned int) mem_reserve);
+    if (reset_peak) mem_peak_used = mon.total_size - mon.free_size;
+    LVGL_UNLOCK
+    
+    return ret;
+}
+
+static PyObject *
+set_mem_reserve(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"size", NULL};
+    unsigned int size;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "I", kwlist, &size)) {
+        return NULL;
+    }
+    mem_reserve = size;
+    
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+set_mem_limit(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"size", NULL};
+    Py_ssize_t size;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &size)) {
+        return NULL;
+    }
+#if PYLV_MEM_ARENA
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be >= 0");
+        return NULL;
+    }
+    LVGL_LOCK
+    arena_limit = size;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+#else
+    PyErr_SetString(PyExc_RuntimeError, "lvgl was not built with the arena allocator (LVGL_MEM_ARENA=1)");
+    return NULL;
+#endif
+}
 
-static lv_color_t disp_buf1[1024 * 10];
-lv_disp_buf_t disp_buffer;
-char framebuffer[LV_HOR_RES_MAX * LV_VER_RES_MAX * 2];
+static PyObject *
+enable_mem_tracing(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"enable", NULL};
+    int enable = 1;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &enable)) {
+        return NULL;
+    }
+#if PYLV_MEM_ARENA
+    LVGL_LOCK
+    arena_trace = enable;
+    if (enable) arena_untrack = true;
+    LVGL_UNLOCK
+    
+    Py_RETURN_NONE;
+#else
+    PyErr_SetString(PyExc_RuntimeError, "lvgl was not built with the arena allocator (LVGL_MEM_ARENA=1)");
+    return NULL;
+#endif
+}
 
+/* Totals of the frame statistics, see frame_stats_t */
+static PyObject *
+pylv_stats(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
+    }
+    
+    LVGL_LOCK
+    ret = frame_stats_to_dict(&frame_totals);
+    if (ret && reset) memset(&frame_totals, 0, sizeof(frame_totals));
+    LVGL_UNLOCK
+    
+    return ret;
+}
 
-/* disp_flush should copy from the VDB (virtual display buffer to the screen.
- * In our case, we copy to the framebuffer
+/* Keep the statistics of the last size frames, to be retrieved using
+ * lvgl.frame_history(). 0 disables the history.
  */
+static PyObject *
+enable_frame_history(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"size", NULL};
+    Py_ssize_t size;
+    frame_stats_t *history = NULL, *old_history;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n", kwlist, &size)) {
+        return NULL;
+    }
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be non-negative");
+        return NULL;
+    }
+    if (size) {
+        history = PyMem_RawMalloc(size * sizeof(frame_stats_t));
+        if (!history) return PyErr_NoMemory();
+    }
+    
+    LVGL_LOCK
+    old_history = frame_history;
+    frame_history = history;
+    frame_history_size = size;
+    frame_history_start = frame_history_len = 0;
+    LVGL_UNLOCK
+    
+    PyMem_RawFree(old_history);
+    Py_RETURN_NONE;
+}
 
- 
-static void disp_flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p) {
-    char *dest = framebuffer + ((area->y1)*LV_HOR_RES_MAX + area->x1) * 2;
-    char *src = (char *) color_p;
+/* Return (and remove) the frames in the history, oldest first */
+static PyObject *
+pylv_frame_history(PyObject *self, PyObject *args) {
+    PyObject *ret, *item;
+    
+    ret = PyList_New(0);
+    if (!ret) return NULL;
+    
+    LVGL_LOCK
+    for (; frame_history_len; frame_history_len--) {
+        item = frame_stats_to_dict(&frame_history[frame_history_start]);
+        if (!item || PyList_Append(ret, item)) {
+            Py_XDECREF(item);
+            Py_CLEAR(ret);
+            break;
+        }
+        Py_DECREF(item);
+        frame_history_start = (frame_history_start + 1) % frame_history_size;
+    }
+    LVGL_UNLOCK
+    
+    return ret;
+}
 
-    for(int32_t y = area->y1; y<=area->y2; y++) {
-        memcpy(dest, src, 2*(area->x2-area->x1+1));
-        src += 2*(area->x2-area->x1+1);
-        dest += 2*LV_HOR_RES_MAX;
+static PyObject *
+lock_stats(PyObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"reset", NULL};
+    int reset = 0;
+    PyObject *ret, *item;
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &reset)) {
+        return NULL;
     }
     
-    lv_disp_flush_ready(disp_drv);
+    ret = PyDict_New();
+    if (!ret) return NULL;
+    
+    LVGL_LOCK
+    for (lock_site_t *site = lock_sites; site; site = site->next) {
+        item = Py_BuildValue("{sKsKsLsL}",
+            "acquisitions", site->acquisitions,
+            "contended", site->contended,
+            "wait_ns", (long long) site->wait_ns,
+            "max_hold_ns", (long long) site->max_hold_ns);
+        if (!item) goto error;
+        
+        PyObject *key = PyUnicode_FromFormat("%s:%d", site->func, site->line);
+        if (!key || PyDict_SetItem(ret, key, item)) {
+            Py_XDECREF(key);
+            Py_DECREF(item);
+            goto error;
+        }
+        Py_DECREF(key);
+        Py_DECREF(item);
+        
+        if (reset) {
+            site->acquisitions = site->contended = 0;
+            site->wait_ns = site->max_hold_ns = 0;
+        }
+    }
+    LVGL_UNLOCK
+    return ret;
+    
+error:
+    LVGL_UNLOCK
+    Py_DECREF(ret);
+    return NULL;
 }
 
-static lv_disp_drv_t display_driver = {0};
-static lv_indev_drv_t indev_driver = {0};
-static int indev_driver_registered = 0;
-static int indev_x, indev_y, indev_state=0;
 
-static bool indev_read(struct _lv_indev_drv_t * indev_drv, lv_indev_data_t *data) {
-    data->point.x = indev_x;
-    data->point.y = indev_y;
-    data->state = indev_state;
+/****************************************************************
+ *  Lazy module attributes                                      *
+ ****************************************************************/
 
-    return false;
+/* Most module attributes (object and struct types, constant classes and
+ * global structs) are created on first access through the module __getattr__
+ * (PEP 562) rather than in PyInit_lvgl, to keep 'import lvgl' fast. Once
+ * created, an attribute is stored in the module dict, so __getattr__ is only
+ * called once per attribute.
+ *
+ * Each entry is one of:
+ *   - a type (object or struct), which is readied on first access
+ *   - an enum class, which is built from enum_items
+ *   - a constant class, which is built by calling build()
+ *   - a global C struct, which is wrapped in a (readonly) struct object
+ */
+
+typedef struct {
+    const char *name;
+    PyTypeObject *type;
+    PyObject *(*build)(void);
+    const void *global;
+    size_t size;
+    const enum_item_t *enum_items;
+    bool enum_flag;
+} lazyattr_t;
+
+// lvgl.aio is implemented in Python, in the lvgl_aio module
+static PyObject *build_aio(void) {
+    return PyImport_ImportModule("lvgl_aio");
+}
+
+static const lazyattr_t lazyattrs[] = {
+<<<objects:
+    {{"{pyname}", &pylv_{name}_Type}},>>>
+<<<structs:
+    {{"{name}", &pylv_{name}_Type}},>>>
+<<ENUM_ASSIGNMENTS>>
+<<SYMBOL_ASSIGNMENTS>>
+<<COLOR_ASSIGNMENTS>>
+<<GLOBALS_ASSIGNMENTS>>
+    {"InputDevice", &InputDevice_Type},
+    {"InputReplay", &InputReplay_Type},
+    {"Task", &pylv_Task_Type},
+#if LV_USE_ANIMATION
+    {"Anim", &pylv_Anim_Type},
+    {"ANIM_PATH", .enum_items = enum_ANIM_PATH_items},
+#endif
+#if LV_USE_GROUP
+    {"Group", &pylv_Group_Type},
+#endif
+#if LV_USE_FILESYSTEM
+    {"FileSystem", &pylv_FileSystem_Type},
+    {"ImageDecoder", &pylv_ImageDecoder_Type},
+#endif
+    {"Theme", &pylv_Theme_Type},
+    {"Font", &pylv_Font_Type},
+    {"ScreenPool", &pylv_ScreenPool_Type},
+    {"aio", NULL, build_aio},
+    {NULL}
+};
+
+static PyObject *
+lazyattr_build(const lazyattr_t *attr) {
+    if (attr->enum_items) return build_enumclass(attr->name, attr->enum_items, attr->enum_flag);
+    if (attr->build) return attr->build();
+    if (attr->global) return pystruct_from_c(attr->type, attr->global, attr->size, 0);
+    
+    if (PyType_Ready(attr->type) < 0) return NULL;
+    Py_INCREF(attr->type);
+    return (PyObject *) attr->type;
 }
 
+static PyObject *
+module_getattr(PyObject *module, PyObject *name) {
+    const char *name_str = PyUnicode_AsUTF8(name);
+    PyObject *value;
+    if (!name_str) return NULL;
+    
+    for (const lazyattr_t *attr = lazyattrs; attr->name; attr++) {
+        if (strcmp(attr->name, name_str) != 0) continue;
+
+        value = lazyattr_build(attr);
+        if (!value) return NULL;
+        
+        // Store in the module dict such that __getattr__ is not called again
+        if (PyObject_SetAttr(module, name, value)) {
+            Py_DECREF(value);
+            return NULL;
+        }
+        return value;
+    }
+    
+    return PyErr_Format(PyExc_AttributeError, "module 'lvgl' has no attribute '%U'", name);
+}
 
 static PyObject *
-send_mouse_event(PyObject *self, PyObject *args, PyObject *kwds) {
-    static char *kwlist[] = {"x", "y", "pressed", NULL};
-    int x=0, y=0, pressed=0;
+module_dir(PyObject *module, PyObject *args) {
+    PyObject *dict = PyModule_GetDict(module); // borrowed reference
+    PyObject *ret = PyDict_Keys(dict);
+    PyObject *name;
+    if (!ret) return NULL;
+
+    for (const lazyattr_t *attr = lazyattrs; attr->name; attr++) {
+        if (PyDict_GetItemString(dict, attr->name)) continue; // already created
+        
+        name = PyUnicode_FromString(attr->name);
+        if (!name || PyList_Append(ret, name)) {
+            Py_XDECREF(name);
+            Py_DECREF(ret);
+            return NULL;
+        }
+        Py_DECREF(name);
+    }
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "iip", kwlist, &x, &y, &pressed)) {
+    if (PyList_Sort(ret)) {
+        Py_DECREF(ret);
         return NULL;
     }
+    return ret;
+}
+
+/* Set __all__ to the public names of the module, including those which are
+ * created on first access, such that 'from lvgl import *' imports (and
+ * creates) all of them. Must be called after all other attributes are added
+ */
+static int
+module_set_all(PyObject *module) {
+    PyObject *dict = PyModule_GetDict(module); // borrowed reference
+    PyObject *names, *key, *value, *all;
+    Py_ssize_t pos = 0;
+    int ret;
     
-    if (!indev_driver_registered) {
-        lv_indev_drv_init(&indev_driver);
-        indev_driver.type = LV_INDEV_TYPE_POINTER;
-        indev_driver.read_cb = indev_read;
-        lv_indev_drv_register(&indev_driver);
-        indev_driver_registered = 1;
+    names = PyList_New(0);
+    if (!names) return -1;
+    
+    while (PyDict_Next(dict, &pos, &key, &value)) {
+        if (!PyUnicode_Check(key) || (PyUnicode_READ_CHAR(key, 0) == '_')) continue;
+        if (PyList_Append(names, key)) goto error;
+    }
+    for (const lazyattr_t *attr = lazyattrs; attr->name; attr++) {
+        // lvgl.aio is a module (which imports asyncio), like a submodule it is
+        // not imported by 'from lvgl import *'
+        if (strcmp(attr->name, "aio") == 0) continue;
+        
+        key = PyUnicode_FromString(attr->name);
+        if (!key || PyList_Append(names, key)) {
+            Py_XDECREF(key);
+            goto error;
+        }
+        Py_DECREF(key);
     }
-    indev_x = x;
-    indev_y = y;
-    indev_state = pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
     
-    Py_RETURN_NONE;
+    all = PyList_AsTuple(names);
+    Py_DECREF(names);
+    if (!all) return -1;
+    ret = PyDict_SetItemString(dict, "__all__", all);
+    Py_DECREF(all);
+    return ret;
+
+error:
+    Py_DECREF(names);
+    return -1;
 }
 
 
@@ -1068,104 +7484,265 @@ send_mouse_event(PyObject *self, PyObject *args, PyObject *kwds) {
 static PyMethodDef lvglMethods[] = {
     {"scr_act",  pylv_scr_act, METH_NOARGS, NULL},
     {"scr_load", (PyCFunction)pylv_scr_load, METH_VARARGS | METH_KEYWORDS, NULL},
-    {"poll", poll, METH_NOARGS, NULL},
+    {"poll", (PyCFunction)poll, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"next_task_deadline_ms", next_task_deadline_ms, METH_NOARGS, NULL},
+    {"wait", (PyCFunction)lvgl_wait, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"anim_count_running", anim_count_running, METH_NOARGS, NULL},
+    {"_set_coroutine_runner", set_coroutine_runner, METH_O, NULL},
+    {"_atexit", lvgl_atexit, METH_NOARGS, NULL},
     {"send_mouse_event", (PyCFunction)send_mouse_event, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"push_input_events", (PyCFunction)pylv_push_input_events, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"push_pointer_events", (PyCFunction)pylv_push_pointer_events, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"set_button_points", (PyCFunction)pylv_set_button_points, METH_VARARGS | METH_KEYWORDS, NULL},
+#if LV_USE_GROUP
+    {"set_group", (PyCFunction)pylv_set_group, METH_VARARGS | METH_KEYWORDS, NULL},
+#endif
+    {"record_input", record_input, METH_NOARGS, NULL},
+    {"stop_input_recording", stop_input_recording, METH_NOARGS, NULL},
+    {"replay_input", (PyCFunction)replay_input, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"enable_threading", (PyCFunction)enable_threading, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"lock_stats", (PyCFunction)lock_stats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"stats", (PyCFunction)pylv_stats, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"mem_info", (PyCFunction)mem_info, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"set_mem_reserve", (PyCFunction)set_mem_reserve, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"set_mem_limit", (PyCFunction)set_mem_limit, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"freelist_info", (PyCFunction)freelist_info, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"set_freelist_size", (PyCFunction)set_freelist_size, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"enable_mem_tracing", (PyCFunction)enable_mem_tracing, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"binding_profile", (PyCFunction)binding_profile, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"enable_frame_history", (PyCFunction)enable_frame_history, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"frame_history", pylv_frame_history, METH_NOARGS, NULL},
+#if LV_USE_FILESYSTEM
+    {"set_image_cache_size", (PyCFunction)set_image_cache_size, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"image_cache_info", (PyCFunction)image_cache_info, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"image_cache_invalidate", (PyCFunction)pylv_image_cache_invalidate, METH_VARARGS | METH_KEYWORDS, NULL},
+#endif
+    {"set_theme", (PyCFunction)set_theme, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"get_theme", get_theme, METH_NOARGS, NULL},
+<<GLOBAL_FUNCTIONS_TABLE>>    {"__getattr__", module_getattr, METH_O, NULL},
+    {"__dir__", module_dir, METH_NOARGS, NULL},
 //    {"report_style_mod", (PyCFunction)report_style_mod, METH_VARARGS | METH_KEYWORDS, NULL},
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
 
 
-static struct PyModuleDef lvglmodule = {
-    PyModuleDef_HEAD_INIT,
-    "lvgl",   /* name of module */
-    NULL, /* module documentation, may be NULL */
-    -1,       /* size of per-interpreter state of the module,
-                 or -1 if the module keeps state in global variables. */
-    lvglMethods
-};
-
 static PyObject*
 Obj_repr(pylv_Obj *self) {
     return PyUnicode_FromFormat("<%s object at %p referencing %p>", Py_TYPE(self)->tp_name, self, self->ref);
 }
 
 
-PyMODINIT_FUNC
-PyInit_lvgl(void) {
-
-    PyObject *module = NULL;
+static int
+lvgl_exec(PyObject *module) {
+    lvgl_state *state = PyModule_GetState(module);
+    PyObject *interp_dict, *atexit, *func, *ret;
     
-    module = PyModule_Create(&lvglmodule);
-    if (!module) goto error;
+    state->interp = PyInterpreterState_Get();
     
     pylv_obj_Type.tp_repr = (reprfunc) Obj_repr;   
     
-    if (PyType_Ready(&Ptr_Type) < 0) return NULL;
+    if (PyType_Ready(&Ptr_Type) < 0) return -1;
     PyModule_AddObject(module, "ptr1", PtrObject_fromptr((void*) 4592));
     PyModule_AddObject(module, "ptr2", PtrObject_fromptr((void*) 4592));
     
-<<<objects:
-    pylv_{name}_Type.tp_base = {base};
-    if (PyType_Ready(&pylv_{name}_Type) < 0) return NULL;
->>>
-
-    if (PyType_Ready(&Blob_Type) < 0) return NULL;
-<<<allstructs:
-    if (PyType_Ready(&pylv_{name}_Type) < 0) return NULL;
->>>
+    // Object and struct types are readied on first access (see module_getattr)
+    // or when the first instance is created
+    if (PyType_Ready(&pylv_obj_Type) < 0) return -1;
+    if (PyType_Ready(&Blob_Type) < 0) return -1;
+    if (PyType_Ready(&InputDevice_Type) < 0) return -1;
+    if (PyType_Ready(&InputReplay_Type) < 0) return -1;
+    
+    PyModule_AddObject(module, LVGL_CAPI_ATTR, PyCapsule_New(&lvgl_capi, LVGL_CAPI_NAME, NULL));
 
-    struct_dict = PyDict_New();
-    if (!struct_dict) return NULL;
+    state->struct_dict = PyDict_New();
+    if (!state->struct_dict) return -1;
+    state->themes = PyDict_New();
+    if (!state->themes) return -1;
     //TODO: remove
-    PyModule_AddObject(module, "_structs_", struct_dict);
-
-<<<objects:
-    Py_INCREF(&pylv_{name}_Type);
-    PyModule_AddObject(module, "{pyname}", (PyObject *) &pylv_{name}_Type); 
->>>
+    Py_INCREF(state->struct_dict);
+    PyModule_AddObject(module, "_structs_", state->struct_dict);
+    
+    // Make the module state available to the static types, see get_state
+    interp_dict = PyInterpreterState_GetDict(state->interp); // borrowed reference
+    if (!interp_dict) {
+        PyErr_SetString(PyExc_RuntimeError, "no interpreter dict available");
+        return -1;
+    }
+    if (PyDict_SetItemString(interp_dict, "lvgl.module", module)) return -1;
+    
+    // Delete the tasks and animations of this interpreter when it exits (atexit
+    // is per interpreter)
+    atexit = PyImport_ImportModule("atexit");
+    if (!atexit) return -1;
+    func = PyObject_GetAttrString(module, "_atexit");
+    ret = func ? PyObject_CallMethod(atexit, "register", "O", func) : NULL;
+    Py_DECREF(atexit);
+    Py_XDECREF(func);
+    if (!ret) return -1;
+    Py_DECREF(ret);
+
+    PyModule_AddObject(module, "framebuffer", PyMemoryView_FromMemory(state->framebuffer, LV_HOR_RES_MAX * LV_VER_RES_MAX * 2, PyBUF_READ));
+    PyModule_AddObject(module, "HOR_RES", PyLong_FromLong(LV_HOR_RES_MAX));
+    PyModule_AddObject(module, "VER_RES", PyLong_FromLong(LV_VER_RES_MAX));
+    PyModule_AddObject(module, "THEME_LIVE_UPDATE", PyBool_FromLong(LV_THEME_LIVE_UPDATE));
+#if PYLV_MEM_ARENA
+    PyModule_AddObject(module, "MEM_TRACE_DOMAIN", PyLong_FromLong(PYLV_MEM_TRACE_DOMAIN));
+#endif
+    if (module_set_all(module)) return -1;
 
-<<<structs:
-    Py_INCREF(&pylv_{name}_Type);
-    PyModule_AddObject(module, "{name}", (PyObject *) &pylv_{name}_Type); 
->>>
 
+    lv_disp_drv_init(&state->display_driver);
+    state->display_driver.hor_res = LV_HOR_RES_MAX;
+    state->display_driver.ver_res = LV_VER_RES_MAX;
     
-<<ENUM_ASSIGNMENTS>>
+    state->display_driver.flush_cb = disp_flush;
+    state->display_driver.monitor_cb = disp_monitor;
+    state->display_driver.user_data = state;
+    
+    lv_disp_buf_init(&state->disp_buffer, state->disp_buf1, NULL, sizeof(state->disp_buf1)/sizeof(lv_color_t));
+    state->display_driver.buffer = &state->disp_buffer;
 
-<<SYMBOL_ASSIGNMENTS>>
+#ifdef Py_GIL_DISABLED
+    // Module instances may be executed concurrently in several threads
+    static PyMutex init_mutex;
+    PyMutex_Lock(&init_mutex);
+#endif
+    if (!rlock_mutex) rlock_mutex = PyThread_allocate_lock();
+    if (!waiters_mutex) waiters_mutex = PyThread_allocate_lock();
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&init_mutex);
+#endif
+    if (!rlock_mutex || !waiters_mutex) {
+        PyErr_NoMemory();
+        return -1;
+    }
 
-<<COLOR_ASSIGNMENTS>>
+    LVGL_LOCK
+    if (!lvgl_initialized) {
+        lv_init();
+        lvgl_initialized = 1;
+#if LV_USE_LOG
+        lv_log_register_print_cb(log_cb);
+#endif
+        
+        // lv_init only creates the animation task, see task_is_idle
+        lv_task_t *task = lv_ll_get_head(&LV_GC_ROOT(_lv_task_ll));
+        for (; task && (n_core_tasks < MAX_CORE_TASKS); task = lv_ll_get_next(&LV_GC_ROOT(_lv_task_ll), task)) {
+            core_tasks[n_core_tasks++] = task;
+        }
+    }
+    
+    state->disp = lv_disp_drv_register(&state->display_driver);
+    LVGL_UNLOCK
 
-<<GLOBALS_ASSIGNMENTS>>
+    return 0;
+}
 
-    // refcount for typesdict is initally 1; it is used by pyobj_from_lv
-    // refcounts to py{name}_Type objects are incremented due to "O" format
-    typesdict = Py_BuildValue("{<<<objects:sO>>>}"<<<objects:,
-        "lv_{name}", &pylv_{name}_Type>>>);
-    
-    PyModule_AddObject(module, "framebuffer", PyMemoryView_FromMemory(framebuffer, LV_HOR_RES_MAX * LV_VER_RES_MAX * 2, PyBUF_READ));
-    PyModule_AddObject(module, "HOR_RES", PyLong_FromLong(LV_HOR_RES_MAX));
-    PyModule_AddObject(module, "VER_RES", PyLong_FromLong(LV_VER_RES_MAX));
+static int
+lvgl_traverse(PyObject *module, visitproc visit, void *arg) {
+    lvgl_state *state = PyModule_GetState(module);
+    if (state) {
+        Py_VISIT(state->struct_dict);
+        Py_VISIT(state->coroutine_runner);
+        Py_VISIT(state->theme);
+        Py_VISIT(state->themes);
+        Py_VISIT(state->scr_act);
+        for (int i = 0; i <= LV_INDEV_TYPE_ENCODER; i++) {
+            Py_VISIT(state->input[i]);
+        }
+    }
+    return 0;
+}
 
+static int
+lvgl_clear(PyObject *module) {
+    lvgl_state *state = PyModule_GetState(module);
+    if (state) {
+        Py_CLEAR(state->struct_dict);
+        Py_CLEAR(state->coroutine_runner);
+        Py_CLEAR(state->theme);
+        Py_CLEAR(state->themes);
+        Py_CLEAR(state->scr_act);
+        for (int i = 0; i <= LV_INDEV_TYPE_ENCODER; i++) {
+            Py_CLEAR(state->input[i]);
+        }
+    }
+    return 0;
+}
 
-    lv_disp_drv_init(&display_driver);
-    display_driver.hor_res = LV_HOR_RES_MAX;
-    display_driver.ver_res = LV_VER_RES_MAX;
+/* lvgl has no way to unregister a display or input device, so they are
+ * retired instead: their screens are deleted (releasing the Python objects
+ * of this interpreter), their tasks are stopped and the drivers no longer
+ * refer to the (freed) module state. This includes input devices of
+ * InputDevice objects which outlive the module.
+ */
+static void
+lvgl_free(void *module) {
+    lvgl_state *state = PyModule_GetState(module);
+    lv_obj_t *scr;
+    lv_indev_t *indev;
     
-    display_driver.flush_cb = disp_flush;
+    if (state && state->disp) {
+        LVGL_LOCK
+        while ((scr = lv_ll_get_head(&state->disp->scr_ll)) != NULL) {
+            lv_obj_del(scr);
+        }
+        lv_task_set_prio(state->disp->refr_task, LV_TASK_PRIO_OFF);
+        state->disp->driver.user_data = NULL;
+        
+        for (indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+            if ((indev->driver.read_cb != indev_read) || (indev->driver.disp != state->disp)) continue;
+            lv_task_set_prio(indev->driver.read_task, LV_TASK_PRIO_OFF);
+            indev->driver.user_data = NULL;
+        }
+        task_delete_all(state->interp);
+#if LV_USE_ANIMATION
+        anim_stop_all(state->interp);
+#endif
+#if LV_USE_FILESYSTEM
+        fs_unregister_all(state->interp);
+        img_decoder_unregister_all(state->interp);
+#endif
+        LVGL_UNLOCK
+    }
+    // retires the default input devices
+    lvgl_clear(module);
     
-    lv_disp_buf_init(&disp_buffer,disp_buf1, NULL, sizeof(disp_buf1)/sizeof(lv_color_t));
-    display_driver.buffer = &disp_buffer;
+    if (PyInterpreterState_Get() == PyInterpreterState_Main()) {
+        freelist_trim(&obj_freelist, 0, PyObject_GC_Del);
+        freelist_trim(&struct_freelist, 0, PyObject_Free);
+    }
+}
 
-    lv_init();
-    
-    lv_disp_drv_register(&display_driver);
+static PyModuleDef_Slot lvgl_slots[] = {
+    {Py_mod_exec, lvgl_exec},
+#ifdef Py_mod_multiple_interpreters
+    // all instances share lvgl and the lvgl lock, which relies on the GIL
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+    // access to lvgl is serialized by the built-in lvgl lock instead
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}
+};
 
-    return module;
-    
-error:
-    Py_XDECREF(module);
-    return NULL;
+static struct PyModuleDef lvglmodule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "lvgl",
+    .m_doc = NULL,
+    .m_size = sizeof(lvgl_state),
+    .m_methods = lvglMethods,
+    .m_slots = lvgl_slots,
+    .m_traverse = lvgl_traverse,
+    .m_clear = lvgl_clear,
+    .m_free = lvgl_free,
+};
+
+
+PyMODINIT_FUNC
+PyInit_lvgl(void) {
+    return PyModuleDef_Init(&lvglmodule);
 }
 
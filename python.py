@@ -1,9 +1,23 @@
 import collections
+import functools
 import re
 import keyword
+import sys
 
 from bindingsgen import Object, Struct, BindingsGenerator, c_ast, stripstart, generate_c, CustomMethod, type_repr, flatten_struct, MissingConversionException
 
+# C enums which are bit flags; these are exposed as enum.IntFlag instead of
+# enum.IntEnum, such that they can be combined using bitwise operators
+flagenums = {
+    'BORDER',
+    'DRAG_DIR',
+    'PROTECT',
+    'TXT_FLAG',
+    'FS_MODE',
+    'CHART_TYPE',
+    'BTNM_CTRL',
+}
+
 # TODO: should be common for all bindings generators
 skipfunctions = {
     
@@ -23,6 +37,114 @@ skipfunctions = {
     
 }
 
+# Families of global functions (lv_<family>_...) for which bindings are
+# generated. Functions which take an lv_<family>_t* as first parameter become
+# methods of the Python type which wraps it (pylv_<Family> in the template,
+# e.g. lvgl.Task); the others become module functions (e.g. lvgl.task_enable)
+globalfamilies = ('task', 'anim', 'group')
+
+skipglobalfunctions = {
+    # lvgl.poll() runs the task handler
+    'lv_task_core_init',
+    'lv_task_handler',
+    
+    # Custom implementation in lvglmodule_template.c (lvgl.Task), which keeps
+    # track of the Python callback and the schedule
+    'lv_task_create',
+    'lv_task_create_basic',
+    'lv_task_set_cb',
+    'lv_task_del',
+    'lv_task_reset',
+    
+    # lv_init initializes the animations
+    'lv_anim_core_init',
+    
+    # Custom implementation in lvglmodule_template.c (lvgl.Anim), which sets
+    # the var and the callbacks and keeps track of the running animations
+    'lv_anim_init',
+    'lv_anim_set_var',
+    'lv_anim_set_exec_cb',
+    'lv_anim_set_custom_exec_cb',
+    'lv_anim_set_path_cb',
+    'lv_anim_set_ready_cb',
+    'lv_anim_create',
+    'lv_anim_del',
+    'lv_anim_get',
+    'lv_anim_count_running',
+    
+    # Paths are selected with lvgl.ANIM_PATH (see Anim.set_path)
+    'lv_anim_path_linear',
+    'lv_anim_path_ease_in',
+    'lv_anim_path_ease_out',
+    'lv_anim_path_ease_in_out',
+    'lv_anim_path_overshoot',
+    'lv_anim_path_bounce',
+    'lv_anim_path_step',
+    
+    # lv_init initializes the groups
+    'lv_group_init',
+    
+    # Custom implementation in lvglmodule_template.c (lvgl.Group), which
+    # detaches a deleted group from the input devices
+    'lv_group_create',
+    'lv_group_del',
+    
+    # Callbacks and the internal style buffer are not exposed; focus changes
+    # are reported to Python by the FOCUSED and DEFOCUSED events
+    'lv_group_set_style_mod_cb',
+    'lv_group_set_style_mod_edit_cb',
+    'lv_group_set_focus_cb',
+    'lv_group_get_style_mod_cb',
+    'lv_group_get_style_mod_edit_cb',
+    'lv_group_get_focus_cb',
+    'lv_group_get_user_data',
+    'lv_group_mod_style',
+}
+
+
+def build_callcode(callcode, restype, resfmt, resctype, lock, unlock):
+    '''
+    Build the C code which calls an lvgl function with the lvgl lock held, and
+    converts its result (of type restype) to Python
+    '''
+    if resctype == 'pylv_Obj *':
+        # Result of function is an lv_obj; find or create the corresponding Python
+        # object using pyobj_from_lv helper
+        return f'''
+    {lock}
+    lv_obj_t *result = {callcode};
+    {unlock}
+    PyObject *retobj = pyobj_from_lv(result);
+    
+    return retobj;
+'''
+    
+    elif resctype is None:
+        return f'''
+    {lock}
+    {callcode};
+    {unlock}
+    Py_RETURN_NONE;
+'''
+    elif resfmt == 'O&':
+        return f'''
+    {lock}
+    {restype} result = {callcode};
+    {unlock}
+    return pystruct_from_lv(result);            
+'''
+    else:
+        code = f'''
+    {lock}
+    {restype} result = {callcode};
+    {unlock}
+'''
+        if resfmt == 'p': # Py_BuildValue does not support 'p' (which is supported by PyArg_ParseTuple..)
+            code += '    if (result) {Py_RETURN_TRUE;} else {Py_RETURN_FALSE;}\n'
+        else:
+            code += f'    return Py_BuildValue("{resfmt}", result);\n'
+        return code
+
 
 class PythonObject(Object):
         
@@ -74,11 +196,18 @@ class PythonObject(Object):
             return '' # Custom implementation is in lvglmodule_template.c
     
         
+        # With profiling, the parse, lock wait and call times are recorded (see BINDING_PROFILE_BEGIN)
+        profile = self.bindingsgenerator.profile
+        methodname = re.match(r'lv_[A-Za-z0-9]+_(\w+)$', method.decl.name).group(1)
+        profilecode = f'    BINDING_PROFILE_BEGIN("{self.pyname}.{methodname}", "{method.decl.name}")\n' if profile else ''
+        lock = 'LVGL_LOCK\n    BINDING_PROFILE_LOCKED' if profile else 'LVGL_LOCK'
+        unlock = 'BINDING_PROFILE_CALLED\n    LVGL_UNLOCK' if profile else 'LVGL_UNLOCK'
+        
         startCode = f'''
 static PyObject*
 py{method.decl.name}(pylv_Obj *self, PyObject *args, PyObject *kwds)
 {{
-    if (check_alive(self)) return NULL;
+{profilecode}    if (check_alive(self)) return NULL;
 '''
        
         paramnames = []
@@ -135,47 +264,15 @@ py{method.decl.name}(pylv_Obj *self, PyObject *args, PyObject *kwds)
                 cvarlist += f', {name}'
         
         code += f'    if (!PyArg_ParseTupleAndKeywords(args, kwds, "{"".join(paramfmts)}", kwlist {crefvarlist})) return NULL;\n'
+        if profile:
+            code += '    BINDING_PROFILE_PARSED\n'
+        # Getters and deletion do not allocate from the lvgl heap, so they are
+        # not refused when the heap is low (see check_mem)
+        if not (methodname.startswith('get_') or methodname in ('del', 'clean')):
+            code += '    if (check_mem()) return NULL;\n'
         
         callcode = f'{method.decl.name}(self->ref{cvarlist})'
-        
-        if resctype == 'pylv_Obj *':
-            # Result of function is an lv_obj; find or create the corresponding Python
-            # object using pyobj_from_lv helper
-            code += f'''
-    LVGL_LOCK
-    lv_obj_t *result = {callcode};
-    LVGL_UNLOCK
-    PyObject *retobj = pyobj_from_lv(result);
-    
-    return retobj;
-'''
-        
-        elif resctype is None:
-            code += f'''
-    LVGL_LOCK         
-    {callcode};
-    LVGL_UNLOCK
-    Py_RETURN_NONE;
-'''
-        elif resfmt == 'O&':
-            code += f'''
-    LVGL_LOCK        
-    {restype} result = {callcode};
-    LVGL_UNLOCK
-    return pystruct_from_lv(result);            
-'''
-        else:
-            code += f'''
-    LVGL_LOCK        
-    {restype} result = {callcode};
-    LVGL_UNLOCK
-'''
-            if resfmt == 'p': # Py_BuildValue does not support 'p' (which is supported by PyArg_ParseTuple..)
-                code += '    if (result) {Py_RETURN_TRUE;} else {Py_RETURN_FALSE;}\n'
-            else:
-                code += f'    return Py_BuildValue("{resfmt}", result);\n'
-   
-            
+        code += build_callcode(callcode, restype, resfmt, resctype, lock, unlock)
         
         return code + '}\n';
 
@@ -243,6 +340,11 @@ class PythonStruct(Struct):
         'int32_t': ('struct_get_int32', 'struct_set_int32'),
         'uint32_t': ('struct_get_uint32', 'struct_set_uint32'),
 
+        # font pointers get / set a font_t (see struct_get_font)
+        'lv_font_t*': ('struct_get_font', 'struct_set_font'),
+        'const lv_font_t*': ('struct_get_font', 'struct_set_font'),
+        'struct _lv_font_struct*': ('struct_get_font', 'struct_set_font'),
+
     
     }
     
@@ -319,6 +421,7 @@ static int
 {setter}(StructObject *self, PyObject *value, void *closure)
 {{
     long v;
+    if (struct_check_readonly(self)) return -1;
     if (long_to_int(value, &v, 0, {2**int(decl.bitsize.value)-1})) return -1;
     ((lv_{self.basename}*)(self->data))->{self.subpath}{decl.name} = v;
     return 0;
@@ -355,6 +458,7 @@ class PythonBindingsGenerator(BindingsGenerator):
     objectclass = PythonObject
     structclass = PythonStruct
     outputfile = 'lvglmodule.c'
+    profile = False # emit per-method profiling code, see get_BINDING_PROFILE
 
     def customize(self):
         # Create self.substructs , which is a collection of derived structs (i.e. structs within structs like lv_style_t_body_border)
@@ -368,9 +472,9 @@ class PythonBindingsGenerator(BindingsGenerator):
         
         
         objects = self.objects
-        objects['obj'].customstructfields.extend(['PyObject_HEAD', 'PyObject *weakreflist;', 'lv_obj_t *ref;', 'PyObject *event_cb;', 'lv_signal_cb_t orig_signal_cb;'])
+        objects['obj'].customstructfields.extend(['PyObject_HEAD', 'PyObject *weakreflist;', 'lv_obj_t *ref;', 'PyObject *event_cb;', 'lv_signal_cb_t orig_signal_cb;', 'PyInterpreterState *interp;', 'PyObject *delete_cbs;', 'bool owned;'])
 
-        for custom in ('lv_obj_get_children', 'lv_obj_set_event_cb', 'lv_label_get_letter_pos', 'lv_label_get_letter_on', 'lv_list_add' ,'lv_obj_get_type', 'lv_list_focus'):
+        for custom in ('lv_obj_get_children', 'lv_obj_set_event_cb', 'lv_label_get_letter_pos', 'lv_label_get_letter_on', 'lv_list_add' ,'lv_obj_get_type', 'lv_list_focus', 'lv_obj_add_delete_cb', 'lv_obj_delete_tree'):
             
             obj, method = re.match('lv_([A-Za-z0-9]+)_(\w+)$', custom).groups()
             objects[obj].methods[method] = CustomMethod(custom)
@@ -404,39 +508,208 @@ class PythonBindingsGenerator(BindingsGenerator):
             return typestr
     
            
-    def get_ENUM_ASSIGNMENTS(self):
-        ret = ''    
+    def get_ENUM_TABLES(self):
+        ret = ''
         for enumname, enum in self.parseresult.enums.items():
 
-            items = ''.join(f', "{name}", {value}' for name, value in enum.items())
-            ret += f'    PyModule_AddObject(module, "{enumname}", build_constclass(\'d\', "{enumname}"{items}, NULL));\n'
+            items = ''.join(f'{{"{name}", {value}}}, ' for name, value in enum.items())
+            ret += f'static const enum_item_t enum_{enumname}_items[] = {{{items}{{NULL}}}};\n'
         return ret
 
-    def get_SYMBOL_ASSIGNMENTS(self):
+    def get_ENUM_ASSIGNMENTS(self):
+        ret = ''    
+        for enumname in self.parseresult.enums:
+            flag = ', .enum_flag = 1' if enumname in flagenums else ''
+            ret += f'    {{"{enumname}", .enum_items = enum_{enumname}_items{flag}}},\n'
+        return ret
+
+    def get_SYMBOL_BUILDER(self):
         
         skip = {'LV_SYMBOL_DEF_H', 'LV_SYMBOL_GLYPH_FIRST', 'LV_SYMBOL_GLYPH_LAST'}
         
-        items = ''.join(f', "{name[10:]}", {name}' for name in self.parseresult.defines if name.startswith('LV_SYMBOL_') and name not in skip)
-        return f'    PyModule_AddObject(module, "SYMBOL", build_constclass(\'s\', "SYMBOL"{items}, NULL));\n'
+        names = [name for name in self.parseresult.defines if name.startswith('LV_SYMBOL_') and name not in skip]
+        namescode = ''.join(f'"{name[10:]}", ' for name in names)
+        valuescode = ', '.join(names)
+        return f'''static const char * const symbol_names[] = {{{namescode}NULL}};
+static const char * const symbol_values[] = {{{valuescode}}};
+
+static PyObject *build_SYMBOL(void) {{
+    return build_constclass(&SYMBOL_Type, 's', symbol_names, symbol_values);
+}}
+'''
 
-    def get_COLOR_ASSIGNMENTS(self):
+    def get_SYMBOL_ASSIGNMENTS(self):
+        return '    {"SYMBOL", NULL, build_SYMBOL},\n'
+
+    def get_COLOR_BUILDER(self):
         
         skip = {'LV_COLOR_H', 'LV_COLOR_MAKE'}
         
-        items = ''.join(f', "{name[9:]}", {name}' for name in self.parseresult.defines if name.startswith('LV_COLOR_') and name not in skip)
-        return f'    PyModule_AddObject(module, "COLOR", build_constclass(\'C\', "COLOR"{items}, NULL));\n'
+        names = [name for name in self.parseresult.defines if name.startswith('LV_COLOR_') and name not in skip]
+        namescode = ''.join(f'"{name[9:]}", ' for name in names)
+        valuescode = ', '.join(names)
+        return f'''static const char * const color_names[] = {{{namescode}NULL}};
+
+static PyObject *build_COLOR(void) {{
+    // Not a static table, since LV_COLOR_MAKE is not a constant expression
+    const lv_color_t color_values[] = {{{valuescode}}};
+    return build_constclass(&COLOR_Type, 'C', color_names, color_values);
+}}
+'''
+
+    def get_COLOR_ASSIGNMENTS(self):
+        return '    {"COLOR", NULL, build_COLOR},\n'
     
     def get_LV_COLOR_TYPE(self):
         return 'py' + self.deref_typedef('lv_color_t') + '_Type'
     
+    def get_BINDING_PROFILE(self):
+        return f'#define BINDING_PROFILE {int(self.profile)}'
+
     def get_GLOBALS_ASSIGNMENTS(self):
         code = ''
         for name, type in self.parseresult.declarations.items():
             typename = type_repr(type)
-            code += f'   PyModule_AddObject(module, "{name}", pystruct_from_c(&py{typename}_Type, &{type.declname}, sizeof({typename}), 0));\n'
+            entry = f'    {{"{name}", &py{typename}_Type, NULL, &{type.declname}, sizeof({typename})}},\n'
+            if type.declname.startswith('lv_font_'):
+                # built-in fonts can be left out of the build (see PYLV_BUILTIN_FONTS in lv_conf.h)
+                option = 'LV_USE_' + type.declname[3:].upper()
+                entry = f'#if !defined({option}) || {option}\n{entry}#endif\n'
+            code += entry
             
         return code
 
+    def build_globalfunctioncode(self, family, function):
+        '''
+        Build the C code for a global function of family: a method of the
+        family's wrapper type if the first parameter is an lv_<family>_t*,
+        a module function otherwise.
+        
+        Returns (code, is_method)
+        '''
+        profile = self.profile
+        name = function.decl.name
+        methodname = re.match(r'lv_[A-Za-z0-9]+_(\w+)$', name).group(1)
+        
+        args = function.decl.type.args
+        params = [param for param in (args.params if args else []) if type_repr(param.type) != 'void']
+        is_method = bool(params) and type_repr(params[0].type) in (f'lv_{family}_t*', f'const lv_{family}_t*')
+        if is_method:
+            params.pop(0)
+            selftype = f'pylv_{family.title()}'
+            pyname = f'{family.title()}.{methodname}'
+        else:
+            selftype = 'PyObject'
+            pyname = f'{family}_{methodname}'
+        
+        paramnames, paramctypes, paramfmts = [], [], []
+        for param in params:
+            paramtype = type_repr(param.type)
+            try:
+                fmt, ctype = PythonObject.TYPECONV_PARAMETER[self.deref_typedef(paramtype)]
+            except KeyError:
+                raise MissingConversionException(f'{name}: Parameter type not found >{paramtype}< ')
+            paramnames.append(param.name)
+            paramctypes.append(ctype)
+            paramfmts.append(fmt)
+        
+        restype = type_repr(function.decl.type.type)
+        if restype == 'void':
+            resfmt, resctype = None, None
+        else:
+            try:
+                resfmt, resctype = PythonObject.TYPECONV_RETURN[self.deref_typedef(restype)]
+            except KeyError:
+                raise MissingConversionException(f'{name}: Return type not found >{restype}< ')
+        
+        profilecode = f'    BINDING_PROFILE_BEGIN("{pyname}", "{name}")\n' if profile else ''
+        checkcode = f'    if (check_{family}(self)) return NULL;\n' if is_method else ''
+        lock = 'LVGL_LOCK\n    BINDING_PROFILE_LOCKED' if profile else 'LVGL_LOCK'
+        unlock = 'BINDING_PROFILE_CALLED\n    LVGL_UNLOCK' if profile else 'LVGL_UNLOCK'
+        
+        code = f'''
+static PyObject*
+py{name}({selftype} *self, PyObject *args, PyObject *kwds)
+{{
+{profilecode}{checkcode}'''
+        kwlist = ''.join('"%s", ' % paramname for paramname in paramnames)
+        code += f'    static char *kwlist[] = {{{kwlist}NULL}};\n'
+        crefvarlist = ''
+        cvarlist = []
+        for paramname, ctype, fmt in zip(paramnames, paramctypes, paramfmts):
+            code += f'    {ctype} {paramname};\n'
+            if ctype == 'pylv_Obj *':
+                crefvarlist += f', &pylv_obj_Type, &{paramname}'
+                cvarlist.append(f'{paramname}->ref')
+            elif fmt == 'O&':
+                crefvarlist += f', py{ctype.rstrip(" *")}_arg_converter, &{paramname}'
+                cvarlist.append(paramname)
+            else:
+                crefvarlist += f', &{paramname}'
+                cvarlist.append(paramname)
+        code += f'    if (!PyArg_ParseTupleAndKeywords(args, kwds, "{"".join(paramfmts)}", kwlist {crefvarlist})) return NULL;\n'
+        for paramname, ctype in zip(paramnames, paramctypes):
+            if ctype == 'pylv_Obj *':
+                code += f'    if (check_alive({paramname})) return NULL;\n'
+        if profile:
+            code += '    BINDING_PROFILE_PARSED\n'
+        # Like object methods (see build_methodcode), except getters and deletion
+        if is_method and not (methodname.startswith('get_') or methodname == 'del'):
+            code += '    if (check_mem()) return NULL;\n'
+        
+        if is_method:
+            cvarlist.insert(0, 'self->ref')
+        callcode = f'{name}({", ".join(cvarlist)})'
+        code += build_callcode(callcode, restype, resfmt, resctype, lock, unlock)
+        
+        return code + '}\n', is_method
+    
+    @functools.cached_property
+    def globalfunctions(self):
+        '''
+        Bindings for the global functions of globalfamilies, as a list of
+        (family, Python name, function, code, is_method)
+
+        This is computed once, since both get_GLOBAL_FUNCTIONS and
+        get_GLOBAL_FUNCTIONS_TABLE use it
+        '''
+        ret = []
+        for name, function in self.parseresult.global_functions.items():
+            match = re.match(r'lv_([A-Za-z0-9]+)_(\w+)$', name)
+            if not match or match.group(1) not in globalfamilies or name in skipglobalfunctions:
+                continue
+            family, methodname = match.groups()
+            try:
+                code, is_method = self.build_globalfunctioncode(family, function)
+            except MissingConversionException as e:
+                print(e)
+                continue
+            pyname = methodname if is_method else f'{family}_{methodname}'
+            if keyword.iskeyword(pyname):
+                pyname += '_'
+            ret.append((family, pyname, function, code, is_method))
+        return ret
+    
+    def get_GLOBAL_FUNCTIONS(self):
+        globalfunctions = self.globalfunctions
+        code = ''.join(item[3] for item in globalfunctions)
+        
+        # The methods of the wrapper type of each family, e.g. PYLV_TASK_METHODS
+        for family in globalfamilies:
+            code += f'\n#define PYLV_{family.upper()}_METHODS \\\n'
+            for itemfamily, pyname, function, _, is_method in globalfunctions:
+                if itemfamily == family and is_method:
+                    code += f'    {{"{pyname}", (PyCFunction) py{function.decl.name}, METH_VARARGS | METH_KEYWORDS, "{generate_c(function.decl)}"}}, \\\n'
+            code += '\n'
+        return code
+    
+    def get_GLOBAL_FUNCTIONS_TABLE(self):
+        code = ''
+        for family, pyname, function, _, is_method in self.globalfunctions:
+            if not is_method:
+                code += f'    {{"{pyname}", (PyCFunction) py{function.decl.name}, METH_VARARGS | METH_KEYWORDS, "{generate_c(function.decl)}"}},\n'
+        return code
+
 if __name__ == '__main__':
     import sourceparser
     #try:
@@ -445,4 +718,6 @@ if __name__ == '__main__':
     parseresult = sourceparser.LvglSourceParser().parse_sources('lvgl')
     
     g = PythonBindingsGenerator(parseresult)
+    # python.py --profile: generate lvglmodule.c with per-method profiling, see lvgl.binding_profile()
+    g.profile = '--profile' in sys.argv[1:]
     g.generate()
@@ -13,14 +13,30 @@ sources = ['lvglmodule.c']
 for path in 'lv_core', 'lv_draw', 'lv_hal', 'lv_misc', 'lv_objx', 'lv_themes', 'lv_fonts':
     sources.extend(glob.glob('lvgl/src/'+ path + '/*.c'))
 
+define_macros = []
+# LVGL_MEM_ARENA=1: use the arena allocator for the lvgl heap (see lvgl_mem.h)
+if os.environ.get('LVGL_MEM_ARENA', '0') != '0':
+    define_macros.append(('PYLV_MEM_ARENA', '1'))
+# LVGL_THEME_LIVE_UPDATE=1: let Theme.apply() re-theme the existing objects
+if os.environ.get('LVGL_THEME_LIVE_UPDATE', '0') != '0':
+    define_macros.append(('PYLV_THEME_LIVE_UPDATE', '1'))
+# LVGL_BUILTIN_FONTS=0: only build in the default font (load others with lvgl.Font)
+if os.environ.get('LVGL_BUILTIN_FONTS', '1') == '0':
+    define_macros.append(('PYLV_BUILTIN_FONTS', '0'))
+
 module1 = Extension('lvgl',
     sources = sources,
+    include_dirs = ['.'],
+    define_macros = define_macros,
+    depends = ['lvgl_capi.h', 'lvgl_mem.h', 'lv_conf.h'],
     extra_compile_args = [] if os.name =='nt' else ["-g","-Wno-unused-function"]
     )
 
 dist = setup (name = 'lvgl',
        version = '0.1',
        description = 'lvgl bindings',
+       py_modules = ['lvgl_aio'],
+       headers = ['lvgl_capi.h'],
        ext_modules = [module1])
 
 for output in dist.get_command_obj('build_ext').get_outputs():